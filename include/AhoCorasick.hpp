@@ -0,0 +1,90 @@
+#ifndef AHO_CORASICK_H
+#define AHO_CORASICK_H
+
+#include <array>
+#include <cstdint>
+#include <queue>
+#include <string>
+#include <vector>
+
+// Multi pattern byte matcher fed one byte at a time, so matches spanning reads are found
+// without buffering. The automaton is built with full transitions, each byte costs one
+// table lookup regardless of the number of patterns.
+class AhoCorasick {
+public:
+
+    static constexpr int NO_MATCH = -1;
+
+    AhoCorasick() { }
+
+    explicit AhoCorasick(const std::vector<std::string>& patterns) { build(patterns); }
+
+    ~AhoCorasick() { }
+
+    void build(const std::vector<std::string>& patterns) {
+
+        mNodes.assign(1, Node{});
+        mState = 0;
+
+        for (size_t id = 0; id < patterns.size(); id++) {
+            if (patterns[id].empty()) continue;
+            int32_t node = 0;
+            for (const auto c : patterns[id]) {
+                const uint8_t b = static_cast<uint8_t>(c);
+                if (mNodes[node].next[b] == 0) {
+                    mNodes[node].next[b] = static_cast<int32_t>(mNodes.size());
+                    mNodes.push_back(Node{});
+                }
+                node = mNodes[node].next[b];
+            }
+            if (mNodes[node].match == NO_MATCH) { mNodes[node].match = static_cast<int32_t>(id); }
+        }
+
+        // breadth first, turning missing edges into jumps along the failure links
+        std::queue<int32_t> queue;
+        for (auto& child : mNodes[0].next) {
+            if (child != 0) { mNodes[child].fail = 0; queue.push(child); }
+        }
+
+        while (!queue.empty()) {
+            const int32_t node = queue.front();
+            queue.pop();
+
+            if (mNodes[node].match == NO_MATCH) { mNodes[node].match = mNodes[mNodes[node].fail].match; }
+
+            for (size_t b = 0; b < 256; b++) {
+                const int32_t child = mNodes[node].next[b];
+                if (child != 0) {
+                    mNodes[child].fail = mNodes[mNodes[node].fail].next[b];
+                    queue.push(child);
+                } else {
+                    mNodes[node].next[b] = mNodes[mNodes[node].fail].next[b];
+                }
+            }
+        }
+    }
+
+    bool empty() const { return mNodes.size() <= 1; }
+
+    void reset() { mState = 0; }
+
+    // Returns the id of a pattern ending at this byte, or NO_MATCH.
+    int feed(const uint8_t b) {
+        mState = mNodes[mState].next[b];
+        return mNodes[mState].match;
+    }
+
+private:
+
+    struct Node {
+        std::array<int32_t, 256> next = {};
+        int32_t fail = 0;
+        int32_t match = NO_MATCH;
+    };
+
+    std::vector<Node> mNodes = std::vector<Node>(1);
+    int32_t mState = 0;
+
+};
+
+#endif // AHO_CORASICK_H
@@ -0,0 +1,180 @@
+#ifndef ANSI_PARSER_H
+#define ANSI_PARSER_H
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+struct TextStyle {
+
+    enum Flags : uint8_t {
+        BOLD      = 1 << 0,
+        DIM       = 1 << 1,
+        ITALIC    = 1 << 2,
+        UNDERLINE = 1 << 3,
+        INVERTED  = 1 << 4,
+        FG_SET    = 1 << 5,
+        BG_SET    = 1 << 6,
+    };
+
+    uint8_t fg = 0;     // 256 color palette index, valid with FG_SET
+    uint8_t bg = 0;     // 256 color palette index, valid with BG_SET
+    uint8_t flags = 0;
+
+    bool isDefault() const { return flags == 0; }
+
+    bool operator==(const TextStyle&) const = default;
+};
+
+// A style that applies from `begin` up to the next run or the end of the line.
+struct StyleRun {
+    uint16_t begin = 0;
+    TextStyle style;
+};
+
+// Incremental parser for ESC sequences. Only SGR (ESC[...m) changes the style, every
+// other CSI, OSC and two byte escape is consumed and dropped so it never reaches the
+// stored text. Sequences may be split across reads.
+class AnsiParser {
+public:
+
+    static constexpr uint8_t ESC = 0x1B;
+
+    AnsiParser() { }
+
+    ~AnsiParser() { }
+
+    bool inSequence() const { return mState != State::Ground; }
+
+    const TextStyle& style() const { return mStyle; }
+
+    void reset() { mState = State::Ground; mStyle = TextStyle{}; }
+
+    // Returns true when the byte completed a sequence that changed the style.
+    bool feed(const uint8_t c) {
+
+        switch (mState) {
+
+            case State::Ground:
+                if (c == ESC) { mState = State::Escape; }
+                return false;
+
+            case State::Escape:
+                if (c == '[') {
+                    mState = State::Csi;
+                    mNumParams = 0;
+                    mParams[0] = 0;
+                } else if (c == ']') {
+                    mState = State::Osc;
+                } else {
+                    mState = State::Ground;
+                }
+                return false;
+
+            case State::Csi:
+                if (c >= '0' && c <= '9') {
+                    mParams[mNumParams] = static_cast<uint16_t>(mParams[mNumParams] * 10 + (c - '0'));
+                } else if (c == ';' || c == ':') {
+                    if (mNumParams + 1 < mParams.size()) { mNumParams++; }
+                    mParams[mNumParams] = 0;
+                } else if (c >= 0x40 && c <= 0x7E) {
+                    mState = State::Ground;
+                    if (c != 'm') return false;
+                    const TextStyle previous = mStyle;
+                    applySgr(mNumParams + 1);
+                    return previous != mStyle;
+                } else if (c < 0x20 || c > 0x7E) {
+                    // not part of a csi sequence, give up on it
+                    mState = State::Ground;
+                }
+                return false;
+
+            case State::Osc:
+                if (c == 0x07) { mState = State::Ground; }
+                else if (c == ESC) { mState = State::OscEscape; }
+                return false;
+
+            case State::OscEscape:
+                mState = (c == '\\') ? State::Ground : State::Osc;
+                return false;
+        }
+
+        return false;
+    }
+
+private:
+
+    enum class State {
+        Ground,
+        Escape,
+        Csi,
+        Osc,
+        OscEscape,
+    };
+
+    State mState = State::Ground;
+    TextStyle mStyle;
+    std::array<uint16_t, 16> mParams = {};
+    size_t mNumParams = 0;
+
+    void applySgr(const size_t count) {
+
+        for (size_t i = 0; i < count; i++) {
+
+            const uint16_t p = mParams[i];
+
+            if (p == 0) {
+                mStyle = TextStyle{};
+            } else if (p == 1) {
+                mStyle.flags |= TextStyle::BOLD;
+            } else if (p == 2) {
+                mStyle.flags |= TextStyle::DIM;
+            } else if (p == 3) {
+                mStyle.flags |= TextStyle::ITALIC;
+            } else if (p == 4) {
+                mStyle.flags |= TextStyle::UNDERLINE;
+            } else if (p == 7) {
+                mStyle.flags |= TextStyle::INVERTED;
+            } else if (p == 22) {
+                mStyle.flags &= ~(TextStyle::BOLD | TextStyle::DIM);
+            } else if (p == 23) {
+                mStyle.flags &= ~TextStyle::ITALIC;
+            } else if (p == 24) {
+                mStyle.flags &= ~TextStyle::UNDERLINE;
+            } else if (p == 27) {
+                mStyle.flags &= ~TextStyle::INVERTED;
+            } else if (p >= 30 && p <= 37) {
+                setFg(static_cast<uint8_t>(p - 30));
+            } else if (p >= 90 && p <= 97) {
+                setFg(static_cast<uint8_t>(p - 90 + 8));
+            } else if (p == 39) {
+                mStyle.flags &= ~TextStyle::FG_SET;
+            } else if (p >= 40 && p <= 47) {
+                setBg(static_cast<uint8_t>(p - 40));
+            } else if (p >= 100 && p <= 107) {
+                setBg(static_cast<uint8_t>(p - 100 + 8));
+            } else if (p == 49) {
+                mStyle.flags &= ~TextStyle::BG_SET;
+            } else if ((p == 38 || p == 48) && i + 2 < count && mParams[i + 1] == 5) {
+                const auto index = static_cast<uint8_t>(mParams[i + 2]);
+                (p == 38) ? setFg(index) : setBg(index);
+                i += 2;
+            } else if ((p == 38 || p == 48) && i + 4 < count && mParams[i + 1] == 2) {
+                // true color is mapped onto the 6x6x6 cube of the 256 color palette
+                const auto cube = [](const uint16_t v) { return static_cast<uint8_t>(std::min<uint16_t>(v, 255) * 5 / 255); };
+                const auto index = static_cast<uint8_t>(16 + 36 * cube(mParams[i + 2]) + 6 * cube(mParams[i + 3]) + cube(mParams[i + 4]));
+                (p == 38) ? setFg(index) : setBg(index);
+                i += 4;
+            }
+        }
+
+    }
+
+    void setFg(const uint8_t index) { mStyle.fg = index; mStyle.flags |= TextStyle::FG_SET; }
+
+    void setBg(const uint8_t index) { mStyle.bg = index; mStyle.flags |= TextStyle::BG_SET; }
+
+};
+
+#endif // ANSI_PARSER_H
@@ -1,25 +1,25 @@
 #include <algorithm>
 #include <cstddef>
-#include <deque>
 #include <ftxui/screen/color.hpp>
 #include <string>
 #include <chrono>
 #include <span>
+#include <vector>
 #include <format>
+#include <iterator>
 
 #include "ftxui/dom/elements.hpp"
+#include "AnsiParser.hpp"
+#include "Exporter.hpp"
+#include "FrameDecoder.hpp"
+#include "Scrollback.hpp"
+#include "Utf8.hpp"
 
 #ifndef ASCII_VIEW_H
 #define ASCII_VIEW_H
 
 using namespace ftxui;
 
-struct SerialData {
-    bool rxtx = false;
-    std::string text;
-    std::chrono::time_point<std::chrono::utc_clock> time;
-};
-
 class AsciiView {
 public:
 
@@ -32,67 +32,98 @@ public:
         using namespace std::chrono;
         
         Elements rows;
-        for (size_t i = mViewIndex; i < std::min(mViewIndex+mRowsOfTextAllowed,mData.size()); i++) {
+        size_t first = mViewIndex;
+
+        // while flooded the newest screenful is shown below a summary of what went past
+        if (isFlooding(steady_clock::now()) && mRowsOfTextAllowed > 1 && mViewIndex + mRowsOfTextAllowed >= mData.size()) {
+            rows.push_back(
+                text(std::format(" {} lines skipped, {:.0f} lines/s, {:.1f} KB/s ", mSkippedRows, mRowsPerSecond, mBytesPerSecond / 1024.0)) | inverted | color(Color::Yellow)
+            );
+            first++;
+        }
+
+        mData.visit(first, mViewIndex + mRowsOfTextAllowed, [&](const SerialData& row) {
 
             if (mViewTimeStamps) {
+                const Color rxtxColor = rowColor(row, Color::Cyan);
                 rows.push_back(
                     hbox({
-                        text(std::format("{:%T} ", floor<milliseconds>(mData.at(i).time))) | color(Color::Green),
-                        text(std::format("[{}] {}", rxOrTxStr[mData.at(i).rxtx], mData.at(i).text)) | color((mData.at(i).rxtx) ? Color::White : Color::Cyan)
+                        text(std::format("{:%T} ", floor<milliseconds>(row.time))) | color(Color::Green),
+                        text(std::format("[{}] ", rxOrTxStr[row.rxtx])) | color(rxtxColor),
+                        rowText(row, rxtxColor)
                     })
                 );
             } else {
-                rows.push_back(text(std::format("[TX] {}", mData.at(i).text)) | color((mData.at(i).rxtx) ? Color::White : Color::Blue));
+                const Color rxtxColor = rowColor(row, Color::Blue);
+                rows.push_back(
+                    hbox({
+                        text(std::format("[{}] ", rxOrTxStr[row.rxtx])) | color(rxtxColor),
+                        rowText(row, rxtxColor)
+                    })
+                );
             }
-        }
+        });
         
         return vflow(rows) | border;
         
     }
 
+    // Escape sequences are interpreted here, once per received byte, and only their
+    // effect is kept as style runs next to the row text.
     void parseBytes(std::span<const uint8_t> slice, const size_t width) {
-        
-        if (mData.size() > 0) {
-            auto& last = mData.back();
-            if (last.text.size() == width || last.text.back() == '\n' || last.rxtx == false) {
-                parseRow(slice, width);
-            } else {
-                const size_t bytesToSearch = std::min(width - last.text.size(), slice.size());
-                const auto it = std::ranges::find(slice.first(bytesToSearch), '\n');
-                             
-                last.text.append(std::string(slice.begin(), (it == slice.end()) ? it : it + 1));
 
-                parseRow(std::span((it == slice.end()) ? it : it + 1, slice.end()), width);
-                
-            }
-        } else {
-            parseRow(slice, width);
+        mBytesAdded += slice.size();
+
+        // a codepoint split across two reads is completed with the first bytes of this one,
+        // the rest is ingested in place
+        if (!mPartialCodepoint.empty()) {
+            const size_t missing = utf8::decode(mPartialCodepoint).length - mPartialCodepoint.size();
+            const auto head = slice.first(std::min(missing, slice.size()));
+            std::vector<uint8_t> joined;
+            std::swap(joined, mPartialCodepoint);
+            joined.insert(joined.end(), head.begin(), head.end());
+            ingest(joined, width);
+            slice = slice.subspan(head.size());
         }
+
+        ingest(slice, width);
         
-        while (mData.size() > mMaxTextRows) { mData.pop_front(); }
+        keepViewPosition();
         
     }
 
-    void parseRow(std::span<const uint8_t> slice, const size_t width) {
+    void addFrame(const Frame& frame, const size_t width) {
+
+        // frames are shown as hex bytes, wrapped over as many rows as needed
+        const size_t bytesPerRow = std::max<size_t>(width / 3, 1);
+        std::span<const uint8_t> bytes(frame.bytes);
+
+        do {
+            const auto chunk = bytes.first(std::min(bytesPerRow, bytes.size()));
+            std::string row;
+            row.reserve(chunk.size() * 3);
+            for (const auto b : chunk) { std::format_to(std::back_inserter(row), "{:02X} ", b); }
+            appendRow(
+                SerialData{
+                    .rxtx = true,
+                    .text = std::move(row),
+                    .time = frame.time,
+                    .frame = true,
+                    .crcError = !frame.crcOk
+                }
+            );
+            bytes = bytes.subspan(chunk.size());
+        } while (!bytes.empty());
+
+        keepViewPosition();
 
-        if (slice.empty()) return;
-        
-        const auto it = std::ranges::find(slice.first(std::min(slice.size(), width)), '\n');
-        mData.emplace_back(
-            SerialData{
-                .rxtx = true,
-                .text = std::string(slice.begin(), (it == slice.end()) ? it : it + 1),
-                .time = std::chrono::utc_clock::now()
-            }
-        );
-        parseRow(std::span((it == slice.end()) ? it : it + 1, slice.end()), width);
     }
 
     size_t getNumRows() { return mData.size(); }
     
     size_t getIndex() { return mViewIndex; }
 
-    void clearView() { mData.clear(); mViewIndex = 0; }
+    void clearView() { mData.clear(); mPendingRaw.clear(); mViewIndex = 0; mSkippedRows = 0; mLastSkip = {}; }
 
     void scrollViewUp(size_t count) { 
         for (size_t i = 0; i < count; i++) {
@@ -110,18 +141,52 @@ public:
                 
     }
 
+    ScrollbackStats getScrollbackStats() const { return mData.getStats(); }
+
+    void setScrollbackBudget(const size_t bytes) { mData.setMemoryBudget(bytes); }
+
+    ExportSource getExportSource(const bool visibleOnly) const {
+        ExportSource source{ .pages = mData.snapshotPages(), .tail = mData.copyTail() };
+        const size_t rows = source.pages.size() * Scrollback::ROWS_PER_PAGE + source.tail.size();
+        source.first = visibleOnly ? std::min(mViewIndex, rows) : 0;
+        source.last = visibleOnly ? std::min(mViewIndex + mRowsOfTextAllowed, rows) : rows;
+        return source;
+    }
+
     void toggleTimeStamps() { mViewTimeStamps = !mViewTimeStamps; }
 
+    void toggleDecimation() { mDecimate = !mDecimate; mSkippedRows = 0; mLastSkip = {}; }
+
+    // Called once per frame with new data. Rows added beyond one screenful since the
+    // previous frame were never on screen, they are only counted for the flood marker.
     void resetView(const size_t viewableTextRows) { 
         mRowsOfTextAllowed = viewableTextRows;
         mViewIndex = (mData.size() < mRowsOfTextAllowed) ? 0 : mData.size() - mRowsOfTextAllowed;
-        
+
+        using namespace std::chrono;
+        const auto now = steady_clock::now();
+
+        if (const auto elapsed = duration<double>(now - mRateStart).count(); elapsed >= 1.0) {
+            mRowsPerSecond = (mRowsAdded - mRateRows) / elapsed;
+            mBytesPerSecond = (mBytesAdded - mRateBytes) / elapsed;
+            mRateStart = now;
+            mRateRows = mRowsAdded;
+            mRateBytes = mBytesAdded;
+        }
+
+        const uint64_t added = mRowsAdded - mRowsAtLastFrame;
+        mRowsAtLastFrame = mRowsAdded;
+        if (!mDecimate || added <= mRowsOfTextAllowed) return;
+
+        if (!isFlooding(now)) { mSkippedRows = 0; }
+        mSkippedRows += added - mRowsOfTextAllowed;
+        mLastSkip = now;
     }
     
     void addTransmitMessage(const std::string& txMsg) {
 
         if (mData.empty()) {
-            mData.push_back(
+            appendRow(
                 SerialData{
                     .rxtx = false,
                     .text = txMsg,
@@ -136,7 +201,7 @@ public:
         if (last.rxtx == false && last.text.back() != '\n') {
             last.text.append(txMsg);
         } else {
-            mData.push_back(
+            appendRow(
                 SerialData{
                     .rxtx = false,
                     .text = txMsg,
@@ -148,14 +213,200 @@ public:
     }
     
 private:
+
+    // Rows wrap on codepoint boundaries at `width` display columns. Pure ascii runs are
+    // found with utf8::asciiPrefix and appended in one go, one column per byte.
+    void ingest(std::span<const uint8_t> slice, const size_t width) {
+
+        while (!slice.empty()) {
+
+            if (mAnsi.inSequence() || slice.front() == AnsiParser::ESC) {
+                keepRawByte(slice.front());
+                if (mAnsi.feed(slice.front())) { applyStyle(); }
+                slice = slice.subspan(1);
+                continue;
+            }
+
+            if (slice.front() & 0x80) {
+
+                const auto cp = utf8::decode(slice);
+
+                if (cp.status == utf8::Status::Incomplete) {
+                    mPartialCodepoint.assign(slice.begin(), slice.end());
+                    return;
+                }
+
+                if (cp.status == utf8::Status::Invalid) {
+                    SerialData& row = openRow(width, 4);
+                    if (row.raw.empty()) { row.raw = row.text; }
+                    row.raw.push_back(static_cast<char>(slice.front()));
+                    std::format_to(std::back_inserter(row.text), "\\x{:02X}", slice.front());
+                    row.columns += 4;
+                    slice = slice.subspan(1);
+                    continue;
+                }
+
+                // a combining mark belongs to the codepoint before it, even on a full row
+                const uint8_t columns = utf8::width(cp.value);
+                SerialData& row = (columns == 0 && canExtend()) ? mData.back() : openRow(width, columns);
+                row.text.append(slice.begin(), slice.begin() + cp.length);
+                if (!row.raw.empty()) { row.raw.append(slice.begin(), slice.begin() + cp.length); }
+                row.columns += columns;
+                slice = slice.subspan(cp.length);
+                continue;
+            }
+
+            SerialData& row = openRow(width, 1);
+            const auto window = slice.first(std::min<size_t>(width - row.columns, slice.size()));
+            const auto ascii = window.first(utf8::asciiPrefix(window));
+            const auto it = std::ranges::find_if(ascii, [](const uint8_t c) { return c == '\n' || c == AnsiParser::ESC; });
+
+            size_t consumed = std::distance(ascii.begin(), it);
+            if (it != ascii.end() && *it == '\n') { consumed++; }
+
+            row.text.append(ascii.begin(), ascii.begin() + consumed);
+            if (!row.raw.empty()) { row.raw.append(ascii.begin(), ascii.begin() + consumed); }
+
+            row.columns += static_cast<uint16_t>(consumed);
+            slice = slice.subspan(consumed);
+        }
+
+    }
+
+    SerialData& appendRow(SerialData&& row) {
+        mRowsAdded++;
+        return mData.emplace_back(std::move(row));
+    }
+
+    // rows dropped by the memory budget shift everything below them up
+    void keepViewPosition() {
+        const size_t dropped = mData.takeDroppedRows();
+        mViewIndex -= std::min(mViewIndex, dropped);
+    }
+
+    bool isFlooding(const std::chrono::steady_clock::time_point now) const {
+        return mDecimate && now - mLastSkip < FLOOD_HOLD;
+    }
+
+    static bool isRowClosed(const SerialData& row, const size_t width) {
+        return row.columns >= width || (!row.text.empty() && row.text.back() == '\n') || !row.rxtx || row.frame;
+    }
+
+    bool canExtend() {
+        return !mData.empty() && mData.back().rxtx && !mData.back().frame && !mData.back().text.empty() && mData.back().text.back() != '\n';
+    }
+
+    SerialData& openRow(const size_t width, const size_t columnsNeeded) {
+
+        if (!mData.empty() && !isRowClosed(mData.back(), width) && mData.back().columns + columnsNeeded <= width) {
+            return mData.back();
+        }
+
+        appendRow(
+            SerialData{
+                .rxtx = true,
+                .time = std::chrono::utc_clock::now()
+            }
+        );
+
+        // escape sequences received between rows belong to the next one
+        mData.back().raw = std::move(mPendingRaw);
+        mPendingRaw.clear();
+
+        // a style that is still active continues on the next row
+        if (!mAnsi.style().isDefault()) {
+            mData.back().styles.push_back(StyleRun{ .begin = 0, .style = mAnsi.style() });
+        }
+
+        return mData.back();
+    }
+
+    // Rows only keep their received bytes once the text stops matching them, that is
+    // after an escape sequence or an invalid byte, so the hex export can rebuild them.
+    void keepRawByte(const uint8_t b) {
+
+        if (mData.empty() || !mData.back().rxtx || mData.back().frame || (!mData.back().text.empty() && mData.back().text.back() == '\n')) {
+            mPendingRaw.push_back(static_cast<char>(b));
+            return;
+        }
+
+        auto& row = mData.back();
+        if (row.raw.empty()) { row.raw = row.text; }
+        row.raw.push_back(static_cast<char>(b));
+    }
+
+    void applyStyle() {
+
+        if (mData.empty()) return;
+
+        auto& row = mData.back();
+        if (!row.rxtx || row.frame || (!row.text.empty() && row.text.back() == '\n')) return;
+
+        const auto begin = static_cast<uint16_t>(row.text.size());
+        if (!row.styles.empty() && row.styles.back().begin == begin) {
+            row.styles.back().style = mAnsi.style();
+        } else if (!row.styles.empty() || !mAnsi.style().isDefault()) {
+            row.styles.push_back(StyleRun{ .begin = begin, .style = mAnsi.style() });
+        }
+    }
+
+    static Element rowText(const SerialData& row, const Color defaultColor) {
+
+        if (row.styles.empty()) { return text(row.text) | color(defaultColor); }
+
+        Elements segments;
+        if (row.styles.front().begin > 0) {
+            segments.push_back(text(row.text.substr(0, row.styles.front().begin)) | color(defaultColor));
+        }
+
+        for (size_t i = 0; i < row.styles.size(); i++) {
+            const size_t begin = std::min<size_t>(row.styles[i].begin, row.text.size());
+            const size_t end = (i + 1 < row.styles.size()) ? std::min<size_t>(row.styles[i + 1].begin, row.text.size()) : row.text.size();
+            if (end <= begin) continue;
+            segments.push_back(styled(text(row.text.substr(begin, end - begin)), row.styles[i].style, defaultColor));
+        }
+
+        return hbox(std::move(segments));
+    }
+
+    static Element styled(Element element, const TextStyle& style, const Color defaultColor) {
+        element |= color((style.flags & TextStyle::FG_SET) ? Color(Color::Palette256(style.fg)) : defaultColor);
+        if (style.flags & TextStyle::BG_SET)    { element |= bgcolor(Color::Palette256(style.bg)); }
+        if (style.flags & TextStyle::BOLD)      { element |= bold; }
+        if (style.flags & TextStyle::DIM)       { element |= dim; }
+        if (style.flags & TextStyle::UNDERLINE) { element |= underlined; }
+        if (style.flags & TextStyle::INVERTED)  { element |= inverted; }
+        return element;
+    }
+
+    static Color rowColor(const SerialData& row, const Color txColor) {
+        if (row.crcError) return Color::Red;
+        return (row.rxtx) ? Color::White : txColor;
+    }
+
     static constexpr std::array<const char*, 2> rxOrTxStr = { "TX", "RX"};
+    static constexpr std::chrono::milliseconds FLOOD_HOLD{1000};
     size_t mViewIndex = 0;
-    size_t mMaxTextRows = 1024;
     bool mViewTimeStamps = true;
     bool mViewTransmit = true;
     
-    std::deque<SerialData> mData;
+    Scrollback mData;
+    AnsiParser mAnsi;
+    std::vector<uint8_t> mPartialCodepoint;
+    std::string mPendingRaw;
     size_t mRowsOfTextAllowed = 0;
+
+    bool mDecimate = true;
+    uint64_t mRowsAdded = 0;
+    uint64_t mBytesAdded = 0;
+    uint64_t mRowsAtLastFrame = 0;
+    uint64_t mSkippedRows = 0;
+    std::chrono::steady_clock::time_point mLastSkip;
+    std::chrono::steady_clock::time_point mRateStart;
+    uint64_t mRateRows = 0;
+    uint64_t mRateBytes = 0;
+    double mRowsPerSecond = 0;
+    double mBytesPerSecond = 0;
     
 };
 
@@ -0,0 +1,195 @@
+#ifndef BAUD_DETECTOR_H
+#define BAUD_DETECTOR_H
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <format>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "serial_windows.hpp"
+
+struct LineSettings {
+    uint32_t baudrate = 115200;
+    Serial::DataBits dataBits = Serial::DataBits::EIGHT;
+    Serial::Parity parity = Serial::Parity::NONE;
+    Serial::StopBits stopBits = Serial::StopBits::ONE;
+
+    std::string toString() const {
+        static constexpr std::array<char, 5> parityChar = {'N', 'O', 'E', 'M', 'S'};
+        return std::format("{} {}{}{}", baudrate, static_cast<int>(dataBits), parityChar[parity], (stopBits == Serial::StopBits::TWO) ? 2 : 1);
+    }
+};
+
+// Samples the line at each candidate setting on a worker thread and keeps the one whose
+// data looks most like text with the fewest framing, parity and break errors reported
+// by the driver. The whole run is bounded by the time budget given to start().
+//
+// The Serial it samples through is owned by the caller and must not be read by anyone
+// else during a run. A closed Serial is opened on the given port and closed again at
+// the end, one that is already open, e.g. with Serial::openSimulated(), is used as is.
+class BaudDetector {
+public:
+
+    struct Result {
+        LineSettings settings;
+        double score = 0;
+        size_t bytes = 0;
+        bool found = false;
+    };
+
+    BaudDetector(Serial& serial) : mSerial(serial) { }
+
+    ~BaudDetector() { cancel(); join(); }
+
+    bool start(const std::string& port, const std::vector<uint32_t>& baudrates, const std::chrono::milliseconds budget = std::chrono::milliseconds(3000)) {
+
+        if (mRunning) return false;
+        join();
+
+        std::vector<LineSettings> candidates;
+        for (const auto framing : sFramings) {
+            for (const auto baudrate : baudrates) {
+                candidates.push_back(LineSettings{ .baudrate = baudrate, .dataBits = framing.dataBits, .parity = framing.parity, .stopBits = framing.stopBits });
+            }
+        }
+
+        mCancel = false;
+        mRunning = true;
+        {
+            std::scoped_lock<std::mutex> lock(mMutex);
+            mResult.reset();
+            mStatus = "detecting ...";
+        }
+
+        mWorker = std::thread([this, port, candidates, budget]() { run(port, candidates, budget); });
+        return true;
+    }
+
+    void cancel() { mCancel = true; }
+
+    bool running() const { return mRunning; }
+
+    // Returns the result once, after the run finished.
+    std::optional<Result> takeResult() {
+        std::scoped_lock<std::mutex> lock(mMutex);
+        return std::exchange(mResult, std::nullopt);
+    }
+
+    std::string getStatus() const {
+        std::scoped_lock<std::mutex> lock(mMutex);
+        return mStatus;
+    }
+
+private:
+
+    static constexpr std::chrono::milliseconds MIN_SAMPLE_TIME{40};
+    static constexpr std::chrono::milliseconds READ_INTERVAL{5};
+    static constexpr size_t CONFIDENT_BYTES = 64;
+    static constexpr double CONFIDENT_SCORE = 0.98;
+
+    static constexpr std::array<LineSettings, 4> sFramings = {{
+        { .dataBits = Serial::DataBits::EIGHT, .parity = Serial::Parity::NONE, .stopBits = Serial::StopBits::ONE },
+        { .dataBits = Serial::DataBits::SEVEN, .parity = Serial::Parity::EVEN, .stopBits = Serial::StopBits::ONE },
+        { .dataBits = Serial::DataBits::SEVEN, .parity = Serial::Parity::ODD,  .stopBits = Serial::StopBits::ONE },
+        { .dataBits = Serial::DataBits::EIGHT, .parity = Serial::Parity::EVEN, .stopBits = Serial::StopBits::ONE },
+    }};
+
+    Serial& mSerial;
+    std::thread mWorker;
+    std::atomic<bool> mRunning = false;
+    std::atomic<bool> mCancel = false;
+    mutable std::mutex mMutex;
+    std::optional<Result> mResult;
+    std::string mStatus;
+
+    void join() { if (mWorker.joinable()) { mWorker.join(); } }
+
+    void setStatus(std::string status) {
+        std::scoped_lock<std::mutex> lock(mMutex);
+        mStatus = std::move(status);
+    }
+
+    void run(const std::string& port, const std::vector<LineSettings>& candidates, const std::chrono::milliseconds budget) {
+
+        using namespace std::chrono;
+
+        Result best;
+        const bool ownsHandle = !mSerial.isConnected();
+
+        if (candidates.empty() || (ownsHandle && mSerial.open(port, candidates.front().baudrate) != Serial::Error::None)) {
+            finish(best, std::format("unable to open {}", port));
+            return;
+        }
+
+        const auto deadline = steady_clock::now() + budget;
+        const auto sampleTime = std::max<milliseconds>(budget / static_cast<int>(candidates.size()), MIN_SAMPLE_TIME);
+        std::vector<uint8_t> buffer;
+
+        for (const auto& candidate : candidates) {
+
+            if (mCancel || steady_clock::now() + sampleTime > deadline) break;
+
+            setStatus(std::format("sampling {}", candidate.toString()));
+            mSerial.applySettings(candidate.baudrate, candidate.dataBits, candidate.parity, candidate.stopBits);
+            mSerial.resetLineErrors();
+
+            size_t total = 0;
+            size_t printable = 0;
+            const auto sampleEnd = steady_clock::now() + sampleTime;
+            while (steady_clock::now() < sampleEnd && !mCancel) {
+                std::this_thread::sleep_for(READ_INTERVAL);
+                mSerial.read();
+                total += mSerial.copyBytes(buffer);
+                for (const auto c : buffer) {
+                    if ((c >= 0x20 && c < 0x7F) || c == '\r' || c == '\n' || c == '\t') { printable++; }
+                }
+            }
+
+            const double candidateScore = score(total, printable, mSerial.getLineErrors());
+            if (total > 0 && (!best.found || candidateScore > best.score)) {
+                best = Result{ .settings = candidate, .score = candidateScore, .bytes = total, .found = true };
+            }
+
+            if (best.found && best.bytes >= CONFIDENT_BYTES && best.score >= CONFIDENT_SCORE) break;
+        }
+
+        if (ownsHandle) { mSerial.close(); }
+
+        if (mCancel) {
+            finish(Result{}, "cancelled");
+        } else if (!best.found) {
+            finish(best, "no data received");
+        } else {
+            finish(best, std::format("found {} ({:.0f}%)", best.settings.toString(), best.score * 100));
+        }
+    }
+
+    // Ratio of printable bytes, reduced for every read that reported a line error. A
+    // wrong baud rate shows as garbage, framing errors and breaks, a wrong parity as
+    // parity errors or bytes with the top bit set.
+    static double score(const size_t total, const size_t printable, const Serial::LineErrors& errors) {
+        if (total == 0) return 0;
+        const uint32_t errorReads = errors.framing + errors.parity + errors.breaks;
+        return static_cast<double>(printable) / total - 0.25 * std::min<uint32_t>(errorReads, 4);
+    }
+
+    void finish(const Result& result, std::string status) {
+        {
+            std::scoped_lock<std::mutex> lock(mMutex);
+            mResult = result;
+            mStatus = std::move(status);
+        }
+        mRunning = false;
+    }
+
+};
+
+#endif // BAUD_DETECTOR_H
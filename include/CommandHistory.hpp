@@ -0,0 +1,159 @@
+#ifndef COMMAND_HISTORY_H
+#define COMMAND_HISTORY_H
+
+#include <cstddef>
+#include <filesystem>
+#include <fstream>
+#include <list>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+// Send history ordered by recency with a hash index for deduplication. Every change is
+// appended to a journal as it happens ("+ cmd" / "- cmd"), so nothing is lost when the
+// application does not exit cleanly. The journal is rewritten from the live entries
+// once it holds mostly superseded records.
+class CommandHistory {
+public:
+
+    using Entries = std::list<std::string>;
+
+    CommandHistory() { }
+
+    ~CommandHistory() { }
+
+    CommandHistory(const CommandHistory&) = delete;
+    CommandHistory& operator=(const CommandHistory&) = delete;
+
+    // Replays the journal, or imports the plain history file of older versions when
+    // there is no journal yet.
+    void load(const std::filesystem::path& journalFile, const std::filesystem::path& legacyFile = {}) {
+
+        mJournalFile = journalFile;
+        bool imported = false;
+
+        if (std::filesystem::exists(mJournalFile)) {
+            std::ifstream file(mJournalFile.string());
+            std::string line;
+            while (std::getline(file, line)) {
+                mJournalRecords++;
+                if (line.size() < 2 || line[1] != ' ') continue;
+                if (line[0] == '+') { insert(line.substr(2)); }
+                if (line[0] == '-') { erase(line.substr(2)); }
+            }
+        } else if (!legacyFile.empty() && std::filesystem::exists(legacyFile)) {
+            std::ifstream file(legacyFile.string());
+            std::string line;
+            while (std::getline(file, line)) {
+                if (!line.empty()) { insert(line); }
+            }
+            imported = true;
+        }
+
+        // a journal that is mostly live entries is only appended to
+        if (imported || needsCompaction()) {
+            compact();
+        } else {
+            std::filesystem::create_directories(mJournalFile.parent_path());
+            mJournal.open(mJournalFile.string(), std::ios::app);
+        }
+    }
+
+    void add(const std::string& cmd) {
+        if (cmd.empty()) return;
+        insert(cmd);
+        journal('+', cmd);
+    }
+
+    void remove(const std::string& cmd) {
+        if (!erase(cmd)) return;
+        journal('-', cmd);
+    }
+
+    bool contains(std::string_view cmd) const { return mIndex.contains(cmd); }
+
+    size_t size() const { return mEntries.size(); }
+
+    bool empty() const { return mEntries.empty(); }
+
+    // most recent first
+    const Entries& entries() const { return mEntries; }
+
+    // Incremented on every change, lets views know their cached filter results are stale.
+    size_t revision() const { return mRevision; }
+
+    void compact() {
+
+        if (mJournalFile.empty()) return;
+
+        mJournal.close();
+        std::filesystem::create_directories(mJournalFile.parent_path());
+
+        const auto tmpFile = std::filesystem::path(mJournalFile).concat(".tmp");
+        {
+            std::ofstream file(tmpFile.string(), std::ios::trunc);
+            for (auto it = mEntries.rbegin(); it != mEntries.rend(); it++) {
+                file << "+ " << *it << '\n';
+            }
+        }
+
+        std::error_code ec;
+        std::filesystem::rename(tmpFile, mJournalFile, ec);
+        mJournalRecords = mEntries.size();
+
+        mJournal.open(mJournalFile.string(), std::ios::app);
+    }
+
+private:
+
+    static constexpr size_t COMPACT_SLACK = 1024;
+
+    Entries mEntries;
+    std::unordered_map<std::string_view, Entries::iterator> mIndex;
+    size_t mRevision = 0;
+
+    std::filesystem::path mJournalFile;
+    std::ofstream mJournal;
+    size_t mJournalRecords = 0;
+
+    void insert(const std::string& cmd) {
+
+        mRevision++;
+
+        if (const auto it = mIndex.find(cmd); it != mIndex.end()) {
+            mEntries.splice(mEntries.begin(), mEntries, it->second);
+            return;
+        }
+
+        mEntries.push_front(cmd);
+        mIndex.emplace(mEntries.front(), mEntries.begin());
+    }
+
+    bool erase(const std::string& cmd) {
+
+        const auto it = mIndex.find(cmd);
+        if (it == mIndex.end()) return false;
+
+        mRevision++;
+        const auto entry = it->second;
+        mIndex.erase(it);
+        mEntries.erase(entry);
+        return true;
+    }
+
+    void journal(const char op, const std::string& cmd) {
+
+        if (!mJournal.is_open()) return;
+
+        mJournal << op << ' ' << cmd << '\n';
+        mJournal.flush();
+
+        mJournalRecords++;
+        if (needsCompaction()) { compact(); }
+    }
+
+    bool needsCompaction() const { return mJournalRecords > 2 * mEntries.size() + COMPACT_SLACK; }
+
+};
+
+#endif // COMMAND_HISTORY_H
@@ -0,0 +1,167 @@
+#ifndef DECODER_PIPELINE_H
+#define DECODER_PIPELINE_H
+
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <format>
+#include <iterator>
+#include <mutex>
+#include <span>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "FrameDecoder.hpp"
+
+// Runs a FrameDecoder on its own thread. Received bytes are handed over with push()
+// and decoded frames are collected by the ui with copyFrames(), so decoding never
+// runs inside the render loop.
+class DecoderPipeline {
+public:
+
+    DecoderPipeline() { mWorker = std::thread([this]() { run(); }); }
+
+    ~DecoderPipeline() {
+        {
+            std::scoped_lock<std::mutex> lock(mMutex);
+            mRunning = false;
+        }
+        mCondition.notify_one();
+        mWorker.join();
+    }
+
+    bool enabled() const { return mEnabled; }
+
+    void setConfig(const FrameDecoderConfig& config) {
+        std::scoped_lock<std::mutex> lock(mMutex);
+        mInput.clear();
+        mFrameEnds.clear();
+        mFrames.clear();
+        mStats = {};
+        mPendingConfig = config;
+        mConfigChanged = true;
+        mEnabled = config.mode != FramingMode::None;
+    }
+
+    FrameDecoderConfig getConfig() const {
+        std::scoped_lock<std::mutex> lock(mMutex);
+        return mPendingConfig;
+    }
+
+    void cycleFramingMode() {
+        auto config = getConfig();
+        config.mode = static_cast<FramingMode>((static_cast<int>(config.mode) + 1) % (static_cast<int>(FramingMode::IdleGap) + 1));
+        setConfig(config);
+    }
+
+    void cycleCrcMode() {
+        auto config = getConfig();
+        config.crc = static_cast<CrcMode>((static_cast<int>(config.crc) + 1) % (static_cast<int>(CrcMode::Crc32) + 1));
+        setConfig(config);
+    }
+
+    void push(std::span<const uint8_t> slice) {
+        if (!mEnabled || slice.empty()) return;
+        {
+            std::scoped_lock<std::mutex> lock(mMutex);
+            mInput.insert(mInput.end(), slice.begin(), slice.end());
+        }
+        mCondition.notify_one();
+    }
+
+    // Marks a frame boundary after the bytes pushed so far, for framing done by the caller.
+    void endFrame() {
+        if (!mEnabled) return;
+        {
+            std::scoped_lock<std::mutex> lock(mMutex);
+            mFrameEnds.push_back(mInput.size());
+        }
+        mCondition.notify_one();
+    }
+
+    size_t copyFrames(std::vector<Frame>& dest) {
+        std::scoped_lock<std::mutex> lock(mMutex);
+        dest.clear();
+        std::swap(dest, mFrames);
+        return dest.size();
+    }
+
+    FrameDecoderStats getStats() const {
+        std::scoped_lock<std::mutex> lock(mMutex);
+        return mStats;
+    }
+
+    std::string getStatus() const {
+        const auto stats = getStats();
+        return std::format("{} {} {} frames {} crc {} err",
+            sFramingModeStr[static_cast<int>(getConfig().mode)], sCrcModeStr[static_cast<int>(getConfig().crc)],
+            stats.frames, stats.crcErrors, stats.framingErrors + stats.overflows);
+    }
+
+private:
+
+    static constexpr std::array<const char*, 7> sFramingModeStr = {"LINES", "DELIM", "SLIP", "COBS", "FIXED", "LENGTH", "GAP"};
+    static constexpr std::array<const char*, 5> sCrcModeStr = {"", "CRC8", "CRC16", "CCITT", "CRC32"};
+
+    void run() {
+
+        std::vector<uint8_t> work;
+        std::vector<size_t> frameEnds;
+        std::vector<Frame> frames;
+        FrameDecoder decoder;
+
+        std::unique_lock<std::mutex> lock(mMutex);
+        while (mRunning) {
+
+            mCondition.wait(lock, [this]() { return !mRunning || !mInput.empty() || !mFrameEnds.empty() || mConfigChanged; });
+
+            if (mConfigChanged) {
+                decoder.setConfig(mPendingConfig);
+                mConfigChanged = false;
+            }
+
+            std::swap(work, mInput);
+            std::swap(frameEnds, mFrameEnds);
+            lock.unlock();
+
+            size_t begin = 0;
+            for (const auto end : frameEnds) {
+                decoder.decode(std::span(work).subspan(begin, end - begin), frames);
+                decoder.endFrame(frames);
+                begin = end;
+            }
+            decoder.decode(std::span(work).subspan(begin), frames);
+            work.clear();
+            frameEnds.clear();
+
+            lock.lock();
+            if (mConfigChanged) {
+                // frames decoded with the old configuration are stale
+                frames.clear();
+                continue;
+            }
+            mFrames.insert(mFrames.end(), std::make_move_iterator(frames.begin()), std::make_move_iterator(frames.end()));
+            mStats = decoder.stats();
+            frames.clear();
+        }
+
+    }
+
+    mutable std::mutex mMutex;
+    std::condition_variable mCondition;
+    std::thread mWorker;
+    bool mRunning = true;
+    std::atomic<bool> mEnabled = false;
+    bool mConfigChanged = false;
+
+    FrameDecoderConfig mPendingConfig;
+    FrameDecoderStats mStats;
+    std::vector<uint8_t> mInput;
+    std::vector<size_t> mFrameEnds;     // offsets into mInput
+    std::vector<Frame> mFrames;
+
+};
+
+#endif // DECODER_PIPELINE_H
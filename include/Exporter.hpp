@@ -0,0 +1,204 @@
+#ifndef EXPORTER_H
+#define EXPORTER_H
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <format>
+#include <iterator>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Scrollback.hpp"
+
+enum class ExportFormat {
+    Text,
+    TimestampedText,
+    HexDump,
+    Csv,
+};
+
+// Rows to export, taken on the ui thread. Only the page handles are copied, the rows
+// of sealed pages are shared with the scrollback.
+struct ExportSource {
+    std::vector<Scrollback::PageRef> pages;
+    Scrollback::Rows tail;
+    size_t first = 0;
+    size_t last = 0;
+};
+
+// Writes scrollback rows to a file on a worker thread. Rows are formatted into a large
+// staging buffer that is flushed with a single write, so the file sees few large writes
+// however many rows there are.
+class Exporter {
+public:
+
+    Exporter() { }
+
+    ~Exporter() { cancel(); join(); }
+
+    bool start(ExportSource source, const std::filesystem::path& file, const ExportFormat format) {
+
+        if (running()) return false;
+        join();
+
+        mCancel = false;
+        mRowsDone = 0;
+        mRowsTotal = source.last - std::min(source.first, source.last);
+        mRunning = true;
+        setResult("");
+
+        mWorker = std::thread([this, source = std::move(source), file, format]() { run(source, file, format); });
+        return true;
+    }
+
+    void cancel() { mCancel = true; }
+
+    bool running() const { return mRunning; }
+
+    // The result of the last export is shown for a few seconds, then the status is empty.
+    std::string getStatus() const {
+        if (mRunning) {
+            return std::format("EXPORT {}%", (mRowsTotal > 0) ? mRowsDone * 100 / mRowsTotal : 100);
+        }
+        std::scoped_lock<std::mutex> lock(mMutex);
+        if (std::chrono::steady_clock::now() - mResultTime > RESULT_HOLD) return "";
+        return mResult;
+    }
+
+    static const char* extension(const ExportFormat format) { return sExtensions[static_cast<int>(format)]; }
+
+    static const char* name(const ExportFormat format) { return sNames[static_cast<int>(format)]; }
+
+private:
+
+    static constexpr size_t STAGING_BYTES = 1 << 20;
+    static constexpr std::chrono::seconds RESULT_HOLD{5};
+    static constexpr std::array<const char*, 4> sExtensions = {".txt", ".txt", ".hex", ".csv"};
+    static constexpr std::array<const char*, 4> sNames = {"TEXT", "TEXT+TIME", "HEX", "CSV"};
+    static constexpr std::array<const char*, 2> sRxOrTx = {"TX", "RX"};
+
+    std::thread mWorker;
+    std::atomic<bool> mRunning = false;
+    std::atomic<bool> mCancel = false;
+    std::atomic<size_t> mRowsDone = 0;
+    std::atomic<size_t> mRowsTotal = 0;
+    mutable std::mutex mMutex;
+    std::string mResult;
+    std::chrono::steady_clock::time_point mResultTime;
+
+    void join() { if (mWorker.joinable()) { mWorker.join(); } }
+
+    void setResult(std::string result) {
+        std::scoped_lock<std::mutex> lock(mMutex);
+        mResult = std::move(result);
+        mResultTime = std::chrono::steady_clock::now();
+    }
+
+    void run(const ExportSource& source, const std::filesystem::path& file, const ExportFormat format) {
+
+        std::FILE* out = std::fopen(file.string().c_str(), "wb");
+        if (out == nullptr) {
+            setResult(std::format("EXPORT FAILED {}", file.string()));
+            mRunning = false;
+            return;
+        }
+
+        std::string staging;
+        staging.reserve(STAGING_BYTES + 4096);
+
+        bool failed = false;
+        const auto flush = [&]() {
+            if (std::fwrite(staging.data(), 1, staging.size(), out) != staging.size()) { failed = true; }
+            staging.clear();
+        };
+
+        if (format == ExportFormat::Csv) { staging += "time,direction,text\n"; }
+
+        const size_t sealedRows = source.pages.size() * Scrollback::ROWS_PER_PAGE;
+        size_t i = source.first;
+
+        while (i < source.last && !mCancel && !failed) {
+
+            if (i >= sealedRows) {
+                if (i - sealedRows >= source.tail.size()) break;
+                formatRow(source.tail[i - sealedRows], format, staging);
+                i++;
+                mRowsDone++;
+            } else {
+                const auto rows = Scrollback::decompress(source.pages[i / Scrollback::ROWS_PER_PAGE]);
+                const size_t pageEnd = std::min(source.last, (i / Scrollback::ROWS_PER_PAGE + 1) * Scrollback::ROWS_PER_PAGE);
+                for (; i < pageEnd; i++) { formatRow((*rows)[i % Scrollback::ROWS_PER_PAGE], format, staging); }
+                mRowsDone = i - source.first;
+            }
+
+            if (staging.size() >= STAGING_BYTES) { flush(); }
+        }
+
+        flush();
+        std::fclose(out);
+
+        if (mCancel) {
+            std::error_code ec;
+            std::filesystem::remove(file, ec);
+            setResult("EXPORT CANCELLED");
+        } else if (failed) {
+            setResult(std::format("EXPORT FAILED {}", file.string()));
+        } else {
+            setResult(std::format("EXPORTED {}", file.filename().string()));
+        }
+
+        mRunning = false;
+    }
+
+    static void formatRow(const SerialData& row, const ExportFormat format, std::string& out) {
+
+        using namespace std::chrono;
+
+        const bool hasNewline = !row.text.empty() && row.text.back() == '\n';
+
+        switch (format) {
+
+            case ExportFormat::Text:
+                // wrapped rx rows are joined again, tx and frame rows stay on their own line
+                out += row.text;
+                if (!hasNewline && (!row.rxtx || row.frame)) { out += '\n'; }
+                break;
+
+            case ExportFormat::TimestampedText:
+                std::format_to(std::back_inserter(out), "{:%T} [{}] {}", floor<milliseconds>(row.time), sRxOrTx[row.rxtx], row.text);
+                if (!hasNewline) { out += '\n'; }
+                break;
+
+            case ExportFormat::HexDump:
+                std::format_to(std::back_inserter(out), "{:%T} [{}]", floor<milliseconds>(row.time), sRxOrTx[row.rxtx]);
+                if (row.frame) {
+                    // decoded frames are stored as hex already
+                    std::format_to(std::back_inserter(out), " {}", row.text);
+                } else {
+                    for (const auto c : row.raw.empty() ? row.text : row.raw) { std::format_to(std::back_inserter(out), " {:02X}", static_cast<uint8_t>(c)); }
+                }
+                out += '\n';
+                break;
+
+            case ExportFormat::Csv:
+                std::format_to(std::back_inserter(out), "{:%F %T},{},\"", floor<milliseconds>(row.time), sRxOrTx[row.rxtx]);
+                for (const auto c : row.text) {
+                    if (c == '\n' || c == '\r') continue;
+                    if (c == '"') { out += '"'; }
+                    out += c;
+                }
+                out += "\"\n";
+                break;
+        }
+    }
+
+};
+
+#endif // EXPORTER_H
@@ -0,0 +1,354 @@
+#ifndef FRAME_DECODER_H
+#define FRAME_DECODER_H
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+enum class FramingMode {
+    None,
+    Delimiter,
+    Slip,
+    Cobs,
+    FixedLength,
+    LengthPrefixed,
+    IdleGap,            // boundaries come from line timing, see GapFramer
+};
+
+enum class CrcMode {
+    None,
+    Crc8,
+    Crc16Modbus,
+    Crc16Ccitt,
+    Crc32,
+};
+
+struct Frame {
+    std::vector<uint8_t> bytes;
+    bool crcOk = true;
+    std::chrono::time_point<std::chrono::utc_clock> time;
+};
+
+struct FrameDecoderConfig {
+    FramingMode mode = FramingMode::None;
+    CrcMode crc = CrcMode::None;
+    uint8_t delimiter = '\n';
+    size_t fixedLength = 16;
+    size_t lengthFieldSize = 1;     // 1 or 2 bytes, counts the bytes following the field (payload + crc)
+    bool lengthBigEndian = false;
+    size_t maxFrameLength = 4096;
+};
+
+struct FrameDecoderStats {
+    size_t frames = 0;
+    size_t crcErrors = 0;
+    size_t framingErrors = 0;
+    size_t overflows = 0;
+};
+
+namespace crc {
+
+    constexpr std::array<uint8_t, 256> makeCrc8Table() {
+        std::array<uint8_t, 256> table{};
+        for (uint32_t i = 0; i < 256; i++) {
+            uint8_t c = static_cast<uint8_t>(i);
+            for (int k = 0; k < 8; k++) { c = (c & 0x80) ? static_cast<uint8_t>((c << 1) ^ 0x07) : static_cast<uint8_t>(c << 1); }
+            table[i] = c;
+        }
+        return table;
+    }
+
+    constexpr std::array<uint16_t, 256> makeCrc16ModbusTable() {
+        std::array<uint16_t, 256> table{};
+        for (uint32_t i = 0; i < 256; i++) {
+            uint16_t c = static_cast<uint16_t>(i);
+            for (int k = 0; k < 8; k++) { c = (c & 1) ? static_cast<uint16_t>((c >> 1) ^ 0xA001) : static_cast<uint16_t>(c >> 1); }
+            table[i] = c;
+        }
+        return table;
+    }
+
+    constexpr std::array<uint16_t, 256> makeCrc16CcittTable() {
+        std::array<uint16_t, 256> table{};
+        for (uint32_t i = 0; i < 256; i++) {
+            uint16_t c = static_cast<uint16_t>(i << 8);
+            for (int k = 0; k < 8; k++) { c = (c & 0x8000) ? static_cast<uint16_t>((c << 1) ^ 0x1021) : static_cast<uint16_t>(c << 1); }
+            table[i] = c;
+        }
+        return table;
+    }
+
+    constexpr std::array<uint32_t, 256> makeCrc32Table() {
+        std::array<uint32_t, 256> table{};
+        for (uint32_t i = 0; i < 256; i++) {
+            uint32_t c = i;
+            for (int k = 0; k < 8; k++) { c = (c & 1) ? (c >> 1) ^ 0xEDB88320u : (c >> 1); }
+            table[i] = c;
+        }
+        return table;
+    }
+
+    inline constexpr auto sCrc8Table        = makeCrc8Table();
+    inline constexpr auto sCrc16ModbusTable = makeCrc16ModbusTable();
+    inline constexpr auto sCrc16CcittTable  = makeCrc16CcittTable();
+    inline constexpr auto sCrc32Table       = makeCrc32Table();
+
+    inline uint8_t crc8(std::span<const uint8_t> data) {
+        uint8_t c = 0;
+        for (const auto b : data) { c = sCrc8Table[c ^ b]; }
+        return c;
+    }
+
+    inline uint16_t crc16Modbus(std::span<const uint8_t> data) {
+        uint16_t c = 0xFFFF;
+        for (const auto b : data) { c = static_cast<uint16_t>((c >> 8) ^ sCrc16ModbusTable[(c ^ b) & 0xFF]); }
+        return c;
+    }
+
+    inline uint16_t crc16Ccitt(std::span<const uint8_t> data) {
+        uint16_t c = 0xFFFF;
+        for (const auto b : data) { c = static_cast<uint16_t>((c << 8) ^ sCrc16CcittTable[((c >> 8) ^ b) & 0xFF]); }
+        return c;
+    }
+
+    inline uint32_t crc32(std::span<const uint8_t> data) {
+        uint32_t c = 0xFFFFFFFFu;
+        for (const auto b : data) { c = (c >> 8) ^ sCrc32Table[(c ^ b) & 0xFF]; }
+        return c ^ 0xFFFFFFFFu;
+    }
+
+    inline size_t size(const CrcMode mode) {
+        switch (mode) {
+            case CrcMode::None: return 0;
+            case CrcMode::Crc8: return 1;
+            case CrcMode::Crc16Modbus: return 2;
+            case CrcMode::Crc16Ccitt: return 2;
+            case CrcMode::Crc32: return 4;
+        }
+        return 0;
+    }
+
+    // The trailing crc bytes are checked against the rest of the frame. Modbus and
+    // CRC-32 are transmitted little endian, CCITT big endian, as on the wire.
+    inline bool check(const CrcMode mode, std::span<const uint8_t> frame) {
+
+        const size_t n = size(mode);
+        if (n == 0) return true;
+        if (frame.size() < n) return false;
+
+        const auto payload = frame.first(frame.size() - n);
+        const auto tail = frame.last(n);
+
+        switch (mode) {
+            case CrcMode::None: return true;
+            case CrcMode::Crc8: return crc8(payload) == tail[0];
+            case CrcMode::Crc16Modbus: return crc16Modbus(payload) == static_cast<uint16_t>(tail[0] | (tail[1] << 8));
+            case CrcMode::Crc16Ccitt: return crc16Ccitt(payload) == static_cast<uint16_t>((tail[0] << 8) | tail[1]);
+            case CrcMode::Crc32: return crc32(payload) == (static_cast<uint32_t>(tail[0]) | (static_cast<uint32_t>(tail[1]) << 8) |
+                                                          (static_cast<uint32_t>(tail[2]) << 16) | (static_cast<uint32_t>(tail[3]) << 24));
+        }
+        return true;
+    }
+
+} // namespace crc
+
+class FrameDecoder {
+public:
+
+    FrameDecoder() { }
+
+    explicit FrameDecoder(const FrameDecoderConfig& config) : mConfig(config) { }
+
+    ~FrameDecoder() { }
+
+    void setConfig(const FrameDecoderConfig& config) { mConfig = config; mStats = {}; reset(); }
+
+    const FrameDecoderConfig& config() const { return mConfig; }
+
+    const FrameDecoderStats& stats() const { return mStats; }
+
+    void reset() {
+        mPending.clear();
+        mEscaped = false;
+        mDiscarding = false;
+    }
+
+    void decode(std::span<const uint8_t> slice, std::vector<Frame>& frames) {
+        switch (mConfig.mode) {
+            case FramingMode::None: return;
+            case FramingMode::Delimiter: decodeDelimited(slice, frames); return;
+            case FramingMode::Slip: decodeSlip(slice, frames); return;
+            case FramingMode::Cobs: decodeCobs(slice, frames); return;
+            case FramingMode::FixedLength: decodeFixedLength(slice, frames); return;
+            case FramingMode::LengthPrefixed: decodeLengthPrefixed(slice, frames); return;
+            case FramingMode::IdleGap: for (const auto b : slice) { append(b); } return;
+        }
+    }
+
+    // Closes the frame at an externally detected boundary, used by the idle gap mode.
+    void endFrame(std::vector<Frame>& frames) {
+        if (!mDiscarding && !mPending.empty()) { emit(frames); }
+        mPending.clear();
+        mDiscarding = false;
+    }
+
+private:
+
+    static constexpr uint8_t SLIP_END     = 0xC0;
+    static constexpr uint8_t SLIP_ESC     = 0xDB;
+    static constexpr uint8_t SLIP_ESC_END = 0xDC;
+    static constexpr uint8_t SLIP_ESC_ESC = 0xDD;
+
+    FrameDecoderConfig mConfig;
+    FrameDecoderStats mStats;
+    std::vector<uint8_t> mPending;
+    bool mEscaped = false;
+    bool mDiscarding = false;
+
+    void emit(std::vector<Frame>& frames) {
+        Frame frame{
+            .bytes = std::move(mPending),
+            .crcOk = true,
+            .time = std::chrono::utc_clock::now()
+        };
+        frame.crcOk = crc::check(mConfig.crc, frame.bytes);
+        if (!frame.crcOk) { mStats.crcErrors++; }
+        mStats.frames++;
+        frames.push_back(std::move(frame));
+        mPending.clear();
+    }
+
+    // Returns false when the byte would exceed the maximum frame length, in which case
+    // the rest of the frame is dropped up to the next frame boundary.
+    bool append(const uint8_t byte) {
+        if (mDiscarding) return false;
+        if (mPending.size() >= mConfig.maxFrameLength) {
+            mStats.overflows++;
+            mPending.clear();
+            mDiscarding = true;
+            return false;
+        }
+        mPending.push_back(byte);
+        return true;
+    }
+
+    void decodeDelimited(std::span<const uint8_t> slice, std::vector<Frame>& frames) {
+        for (const auto b : slice) {
+            if (b == mConfig.delimiter) {
+                if (!mDiscarding && !mPending.empty()) { emit(frames); }
+                mDiscarding = false;
+            } else {
+                append(b);
+            }
+        }
+    }
+
+    void decodeSlip(std::span<const uint8_t> slice, std::vector<Frame>& frames) {
+        for (const auto b : slice) {
+            if (b == SLIP_END) {
+                if (!mDiscarding && !mPending.empty()) { emit(frames); }
+                mPending.clear();
+                mEscaped = false;
+                mDiscarding = false;
+            } else if (mEscaped) {
+                mEscaped = false;
+                if (b == SLIP_ESC_END) {
+                    append(SLIP_END);
+                } else if (b == SLIP_ESC_ESC) {
+                    append(SLIP_ESC);
+                } else {
+                    if (!mDiscarding) { mStats.framingErrors++; }
+                    mPending.clear();
+                    mDiscarding = true;
+                }
+            } else if (b == SLIP_ESC) {
+                mEscaped = true;
+            } else {
+                append(b);
+            }
+        }
+    }
+
+    void decodeCobs(std::span<const uint8_t> slice, std::vector<Frame>& frames) {
+        for (const auto b : slice) {
+            if (b != 0x00) {
+                append(b);
+                continue;
+            }
+            if (!mDiscarding && !mPending.empty()) {
+                if (unstuffCobs()) {
+                    emit(frames);
+                } else {
+                    mStats.framingErrors++;
+                }
+            }
+            mPending.clear();
+            mDiscarding = false;
+        }
+    }
+
+    // Decodes mPending in place, the decoded frame is never longer than the encoded one.
+    bool unstuffCobs() {
+        size_t read = 0;
+        size_t write = 0;
+        const size_t n = mPending.size();
+        while (read < n) {
+            const uint8_t code = mPending[read++];
+            if (read + code - 1 > n) return false;
+            for (uint8_t i = 1; i < code; i++) { mPending[write++] = mPending[read++]; }
+            if (code < 0xFF && read < n) { mPending[write++] = 0x00; }
+        }
+        mPending.resize(write);
+        return true;
+    }
+
+    void decodeFixedLength(std::span<const uint8_t> slice, std::vector<Frame>& frames) {
+        const size_t length = std::max<size_t>(mConfig.fixedLength, 1);
+        while (!slice.empty()) {
+            const size_t take = std::min(length - mPending.size(), slice.size());
+            mPending.insert(mPending.end(), slice.begin(), slice.begin() + take);
+            slice = slice.subspan(take);
+            if (mPending.size() == length) { emit(frames); }
+        }
+    }
+
+    void decodeLengthPrefixed(std::span<const uint8_t> slice, std::vector<Frame>& frames) {
+        const size_t header = (mConfig.lengthFieldSize == 2) ? 2 : 1;
+        while (!slice.empty()) {
+
+            if (mPending.size() < header) {
+                mPending.push_back(slice.front());
+                slice = slice.subspan(1);
+                continue;
+            }
+
+            size_t length = mPending[0];
+            if (header == 2) {
+                length = mConfig.lengthBigEndian ? (mPending[0] << 8) | mPending[1] : mPending[0] | (mPending[1] << 8);
+            }
+
+            if (length > mConfig.maxFrameLength) {
+                // a corrupt length field, resynchronize by sliding one byte
+                mStats.overflows++;
+                mPending.erase(mPending.begin());
+                continue;
+            }
+
+            const size_t take = std::min(header + length - mPending.size(), slice.size());
+            mPending.insert(mPending.end(), slice.begin(), slice.begin() + take);
+            slice = slice.subspan(take);
+
+            if (mPending.size() == header + length) {
+                mPending.erase(mPending.begin(), mPending.begin() + header);
+                emit(frames);
+            }
+        }
+    }
+
+};
+
+#endif // FRAME_DECODER_H
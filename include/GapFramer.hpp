@@ -0,0 +1,138 @@
+#ifndef GAP_FRAMER_H
+#define GAP_FRAMER_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <format>
+#include <limits>
+#include <mutex>
+#include <span>
+#include <string>
+
+#include "DecoderPipeline.hpp"
+
+struct GapStats {
+    size_t frames = 0;
+    size_t minLength = 0;
+    size_t maxLength = 0;
+    double meanLength = 0;
+    std::chrono::microseconds minGap{0};    // idle time between the end of a frame and the next
+    std::chrono::microseconds maxGap{0};
+    std::chrono::microseconds meanGap{0};
+};
+
+// Frames timing delimited protocols like Modbus RTU, where silence on the line ends a
+// frame. Runs on the reader thread: received bytes go straight to the DecoderPipeline
+// and onPoll() marks a frame boundary once no byte was read for longer than the gap.
+// Bytes are not timestamped on arrival but at the poll that read them, so a gap is only
+// resolved to the 1 ms poll period plus Sleep jitter, about 1-2 ms. The gap is fixed at
+// 1.75 ms at any rate above 19200 baud, where frames closer than that may merge.
+class GapFramer {
+public:
+
+    static constexpr std::chrono::microseconds RESOLUTION{2000};
+
+    GapFramer(DecoderPipeline& pipeline) : mPipeline(pipeline) { }
+
+    ~GapFramer() { }
+
+    void setEnabled(const bool enabled) {
+        std::scoped_lock<std::mutex> lock(mMutex);
+        mEnabled = enabled;
+        mInFrame = false;
+        mStats = {};
+        mTotalLength = 0;
+        mTotalGap = {};
+        mGaps = 0;
+    }
+
+    bool enabled() const { return mEnabled; }
+
+    // 0 derives the gap from the line settings.
+    void setGap(const std::chrono::microseconds gap) { mFixedGap = gap; }
+
+    // 3.5 character times as in the Modbus RTU spec, which fixes it at 1.75 ms above 19200 baud.
+    void setLineSettings(const uint32_t baudrate, const uint32_t bitsPerCharacter) {
+        if (baudrate == 0) return;
+        mAutoGap = (baudrate > 19200) ? std::chrono::microseconds(1750)
+                                      : std::chrono::microseconds(static_cast<int64_t>(3.5 * bitsPerCharacter * 1e6 / baudrate));
+    }
+
+    std::chrono::microseconds gap() const { return (mFixedGap.load().count() > 0) ? mFixedGap.load() : mAutoGap.load(); }
+
+    void onReceive(std::span<const uint8_t> data, const std::chrono::steady_clock::time_point time) {
+
+        std::scoped_lock<std::mutex> lock(mMutex);
+        if (!mEnabled || data.empty()) return;
+
+        if (!mInFrame) {
+            if (mStats.frames > 0) { recordGap(std::chrono::duration_cast<std::chrono::microseconds>(time - mLastByte)); }
+            mInFrame = true;
+            mFrameLength = 0;
+        }
+
+        mPipeline.push(data);
+        mFrameLength += data.size();
+        mLastByte = time;
+    }
+
+    // Called after every read. Bytes read together can not be split, so only an idle
+    // poll ends a frame, never the time between two reads that both returned data.
+    void onPoll(const std::chrono::steady_clock::time_point now) {
+
+        std::scoped_lock<std::mutex> lock(mMutex);
+        if (!mEnabled || !mInFrame || now - mLastByte < gap()) return;
+
+        mPipeline.endFrame();
+        mInFrame = false;
+
+        mStats.minLength = (mStats.frames == 0) ? mFrameLength : std::min(mStats.minLength, mFrameLength);
+        mStats.maxLength = std::max(mStats.maxLength, mFrameLength);
+        mStats.frames++;
+        mTotalLength += mFrameLength;
+        mStats.meanLength = static_cast<double>(mTotalLength) / mStats.frames;
+    }
+
+    GapStats getStats() const {
+        std::scoped_lock<std::mutex> lock(mMutex);
+        return mStats;
+    }
+
+    std::string getStatus() const {
+        if (!mEnabled) return "";
+        const auto stats = getStats();
+        const auto ms = [](const std::chrono::microseconds us) { return us.count() / 1000.0; };
+        return std::format("gap {:.2f}ms (+-{:.0f}ms) len {}/{:.1f}/{} idle {:.2f}/{:.2f}/{:.2f}ms",
+            ms(gap()), ms(RESOLUTION), stats.minLength, stats.meanLength, stats.maxLength, ms(stats.minGap), ms(stats.meanGap), ms(stats.maxGap));
+    }
+
+private:
+
+    DecoderPipeline& mPipeline;
+    mutable std::mutex mMutex;
+    std::atomic<bool> mEnabled = false;
+    std::atomic<std::chrono::microseconds> mFixedGap{std::chrono::microseconds(0)};
+    std::atomic<std::chrono::microseconds> mAutoGap{std::chrono::microseconds(1750)};
+
+    bool mInFrame = false;
+    size_t mFrameLength = 0;
+    std::chrono::steady_clock::time_point mLastByte;
+
+    GapStats mStats;
+    size_t mTotalLength = 0;
+    std::chrono::microseconds mTotalGap{0};
+    size_t mGaps = 0;
+
+    void recordGap(const std::chrono::microseconds gap) {
+        mStats.minGap = (mGaps == 0) ? gap : std::min(mStats.minGap, gap);
+        mStats.maxGap = std::max(mStats.maxGap, gap);
+        mGaps++;
+        mTotalGap += gap;
+        mStats.meanGap = mTotalGap / mGaps;
+    }
+
+};
+
+#endif // GAP_FRAMER_H
@@ -0,0 +1,80 @@
+#ifndef LATENCY_HISTOGRAM_H
+#define LATENCY_HISTOGRAM_H
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <limits>
+
+// HdrHistogram style log-linear histogram of microsecond values. Every power of two is
+// split into SUB_BUCKETS linear buckets, so each recorded value is kept with a relative
+// error below 1 / SUB_BUCKETS over the whole range while the storage stays fixed.
+class LatencyHistogram {
+public:
+
+    static constexpr uint32_t SUB_BITS    = 5;
+    static constexpr uint64_t SUB_BUCKETS = 1 << SUB_BITS;                  // 32, ~3% resolution
+    static constexpr uint64_t MAX_VALUE   = (uint64_t(1) << 36) - 1;          // ~19 hours in us
+
+    LatencyHistogram() { }
+
+    void record(uint64_t value) {
+        value = std::min(value, MAX_VALUE);
+        mCounts[index(value)]++;
+        mCount++;
+        mMin = std::min(mMin, value);
+        mMax = std::max(mMax, value);
+    }
+
+    void clear() {
+        mCounts.fill(0);
+        mCount = 0;
+        mMin = std::numeric_limits<uint64_t>::max();
+        mMax = 0;
+    }
+
+    uint64_t count() const { return mCount; }
+
+    uint64_t min() const { return (mCount > 0) ? mMin : 0; }
+
+    uint64_t max() const { return mMax; }
+
+    // Upper bound of the bucket holding the given percentile, clamped to the exact max.
+    uint64_t percentile(const double p) const {
+        if (mCount == 0) return 0;
+        const uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(p / 100.0 * mCount + 0.5));
+        uint64_t seen = 0;
+        for (size_t i = 0; i < mCounts.size(); i++) {
+            seen += mCounts[i];
+            if (seen >= rank) return std::clamp(highestEquivalent(i), mMin, mMax);
+        }
+        return mMax;
+    }
+
+private:
+
+    static constexpr size_t BUCKETS = 2 * SUB_BUCKETS + (36 - SUB_BITS - 1) * SUB_BUCKETS;
+
+    std::array<uint64_t, BUCKETS> mCounts = {};
+    uint64_t mCount = 0;
+    uint64_t mMin = std::numeric_limits<uint64_t>::max();
+    uint64_t mMax = 0;
+
+    // values below 2 * SUB_BUCKETS are exact, above that the top SUB_BITS + 1 bits select the bucket
+    static size_t index(const uint64_t value) {
+        if (value < 2 * SUB_BUCKETS) return static_cast<size_t>(value);
+        const uint32_t shift = static_cast<uint32_t>(std::bit_width(value)) - (SUB_BITS + 1);
+        return static_cast<size_t>(2 * SUB_BUCKETS + (shift - 1) * SUB_BUCKETS + ((value >> shift) - SUB_BUCKETS));
+    }
+
+    static uint64_t highestEquivalent(const size_t i) {
+        if (i < 2 * SUB_BUCKETS) return i;
+        const uint64_t shift = (i - 2 * SUB_BUCKETS) / SUB_BUCKETS + 1;
+        const uint64_t top = (i - 2 * SUB_BUCKETS) % SUB_BUCKETS + SUB_BUCKETS;
+        return ((top + 1) << shift) - 1;
+    }
+
+};
+
+#endif // LATENCY_HISTOGRAM_H
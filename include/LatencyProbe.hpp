@@ -0,0 +1,226 @@
+#ifndef LATENCY_PROBE_H
+#define LATENCY_PROBE_H
+
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <format>
+#include <mutex>
+#include <span>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+
+#include "AhoCorasick.hpp"
+#include "LatencyHistogram.hpp"
+#include "serial_windows.hpp"
+
+struct LatencyConfig {
+    std::string request;                        // sent as is, see unescape()
+    std::string reply;                          // substring that completes a round trip
+    std::chrono::milliseconds interval{100};
+    std::chrono::milliseconds timeout{1000};
+};
+
+// Round trip latency mode. A worker thread sends the request at a fixed rate, one
+// request in flight at a time, and takes the TX timestamp once the write returned.
+// The reply is matched on the reader thread through a receive listener, so the RX
+// timestamp is the read that delivered the last byte of the reply pattern. A reply
+// that beats the return of the write is measured from the start of the write instead.
+class LatencyProbe {
+public:
+
+    LatencyProbe(Serial& serial) : mSerial(serial) { }
+
+    ~LatencyProbe() { stop(); }
+
+    void configure(LatencyConfig config) {
+        stop();
+        std::scoped_lock<std::mutex> lock(mMutex);
+        mConfig = std::move(config);
+        mMatcher.build({ mConfig.reply });
+    }
+
+    bool configured() const { return !mConfig.request.empty() && !mConfig.reply.empty(); }
+
+    void start() {
+        if (!configured() || mRunning) return;
+        {
+            std::scoped_lock<std::mutex> lock(mMutex);
+            mHistogram.clear();
+            mTimeouts = 0;
+            mLateReplies = 0;
+            mSendOverhead = {};
+            mState = State::Idle;
+            mStop = false;
+        }
+        mRunning = true;
+        mWorker = std::thread([this]() { run(); });
+    }
+
+    void stop() {
+        {
+            std::scoped_lock<std::mutex> lock(mMutex);
+            mStop = true;
+        }
+        mCondition.notify_one();
+        if (mWorker.joinable()) { mWorker.join(); }
+        mRunning = false;
+    }
+
+    void toggle() { if (mRunning) { stop(); } else { start(); } }
+
+    bool running() const { return mRunning; }
+
+    void onReceive(std::span<const uint8_t> data, const std::chrono::steady_clock::time_point time) {
+
+        std::scoped_lock<std::mutex> lock(mMutex);
+        if (mState == State::Idle) return;
+
+        for (const auto b : data) {
+            if (mMatcher.feed(b) == AhoCorasick::NO_MATCH) continue;
+            switch (mState) {
+                case State::Waiting:
+                    mHistogram.record(std::max<int64_t>(0, std::chrono::duration_cast<std::chrono::microseconds>(time - mTxTime).count()));
+                    mState = State::Idle;
+                    mCondition.notify_one();
+                    break;
+                case State::Sending:
+                    // the reply overtook the return of the write call, measured from its start
+                    mReplyTime = time;
+                    mState = State::RepliedEarly;
+                    break;
+                case State::TimedOut:
+                    mLateReplies++;
+                    mState = State::Idle;
+                    mCondition.notify_one();
+                    break;
+                default:
+                    break;
+            }
+            return;
+        }
+    }
+
+    std::string getStatus() const {
+        if (!configured()) return "";
+        std::scoped_lock<std::mutex> lock(mMutex);
+        const auto ms = [](const uint64_t us) { return us / 1000.0; };
+        return std::format("LAT{} n={} min {:.2f} p50 {:.2f} p99 {:.2f} max {:.2f}ms TO {} late {} tx {:.2f}ms",
+            mRunning ? "" : " OFF", mHistogram.count(), ms(mHistogram.min()), ms(mHistogram.percentile(50)), ms(mHistogram.percentile(99)),
+            ms(mHistogram.max()), mTimeouts, mLateReplies, std::chrono::duration<double, std::milli>(mSendOverhead).count());
+    }
+
+    // Turns \r, \n, \t, \\ and \xNN in command line arguments into bytes.
+    static std::string unescape(std::string_view text) {
+        std::string out;
+        for (size_t i = 0; i < text.size(); i++) {
+            if (text[i] != '\\' || i + 1 == text.size()) { out += text[i]; continue; }
+            switch (text[++i]) {
+                case 'r': out += '\r'; break;
+                case 'n': out += '\n'; break;
+                case 't': out += '\t'; break;
+                case 'x': {
+                    uint8_t value = 0;
+                    const auto [ptr, ec] = std::from_chars(text.data() + i + 1, text.data() + std::min(i + 3, text.size()), value, 16);
+                    if (ec == std::errc()) { out += static_cast<char>(value); i = ptr - text.data() - 1; } else { out += "\\x"; }
+                    break;
+                }
+                default: out += text[i]; break;
+            }
+        }
+        return out;
+    }
+
+private:
+
+    enum class State {
+        Idle,
+        Sending,
+        RepliedEarly,
+        Waiting,
+        TimedOut,   // a reply now is late, it is counted and never measured
+    };
+
+    Serial& mSerial;
+    LatencyConfig mConfig;
+    AhoCorasick mMatcher;
+
+    std::thread mWorker;
+    std::atomic<bool> mRunning = false;
+    mutable std::mutex mMutex;
+    std::condition_variable mCondition;
+    bool mStop = false;
+
+    State mState = State::Idle;
+    std::chrono::steady_clock::time_point mTxTime;
+    std::chrono::steady_clock::time_point mReplyTime;
+    LatencyHistogram mHistogram;
+    uint32_t mTimeouts = 0;
+    uint32_t mLateReplies = 0;
+    std::chrono::steady_clock::duration mSendOverhead{};   // longest write call
+
+    void run() {
+
+        using namespace std::chrono;
+
+        auto nextSend = steady_clock::now();
+
+        std::unique_lock<std::mutex> lock(mMutex);
+        while (!mStop) {
+
+            // a request in flight blocks until its reply or timeout, a send slot missed meanwhile is taken right after
+            if (mState == State::Waiting) {
+                if (!mCondition.wait_until(lock, mTxTime + mConfig.timeout, [&]() { return mStop || mState != State::Waiting; })) {
+                    mTimeouts++;
+                    mState = State::TimedOut;
+                }
+                continue;
+            }
+
+            // the next request waits one more timeout for a late reply, which would otherwise be taken as its own
+            if (mState == State::TimedOut) {
+                mCondition.wait_until(lock, mTxTime + 2 * mConfig.timeout, [&]() { return mStop || mState != State::TimedOut; });
+                mState = State::Idle;
+                continue;
+            }
+
+            mCondition.wait_until(lock, nextSend, [&]() { return mStop || steady_clock::now() >= nextSend; });
+            if (mStop) break;
+
+            mMatcher.reset();
+            mState = State::Sending;
+
+            // the serial mutex is taken by the reader while it calls onReceive, never send with ours held
+            lock.unlock();
+            const auto before = steady_clock::now();
+            const bool sent = mSerial.send(mConfig.request.data(), mConfig.request.size());
+            const auto after = steady_clock::now();
+            lock.lock();
+
+            mSendOverhead = std::max(mSendOverhead, after - before);
+            mTxTime = after;
+
+            if (!sent) {
+                mState = State::Idle;
+            } else if (mState == State::RepliedEarly) {
+                mHistogram.record(std::max<int64_t>(0, duration_cast<microseconds>(mReplyTime - before).count()));
+                mState = State::Idle;
+            } else {
+                mState = State::Waiting;
+            }
+
+            // a fixed rate, but never a burst to catch up after a slow reply
+            nextSend = std::max(nextSend + mConfig.interval, after);
+        }
+
+        mState = State::Idle;
+    }
+
+};
+
+#endif // LATENCY_PROBE_H
@@ -0,0 +1,242 @@
+#ifndef PLOT_VIEW_H
+#define PLOT_VIEW_H
+
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <cmath>
+#include <cstdint>
+#include <format>
+#include <limits>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "ftxui/dom/canvas.hpp"
+#include "ftxui/dom/elements.hpp"
+#include "circular_buffer.hpp"
+
+using namespace ftxui;
+
+// Plots numeric telemetry fields extracted from received lines. Lines are either
+// plain values ("1.0, 2.5, -3") which become series col0, col1, ... or key/value
+// pairs ("temp=21.5 rpm:1200").
+class PlotView {
+public:
+
+    static constexpr size_t MAX_SERIES  = 8;
+    static constexpr size_t MAX_SAMPLES = 4096;
+
+    PlotView() { mLine.reserve(256); }
+
+    ~PlotView() { }
+
+    void toggleView() { mEnableView = !mEnableView; }
+
+    bool enabled() const { return mEnableView; }
+
+    void clear() { mSeries.clear(); mLine.clear(); mLineOverflow = false; }
+
+    void parseBytes(std::span<const uint8_t> slice) {
+        for (const auto c : slice) {
+            if (c == '\n' || c == '\r') {
+                // a line cut at the capacity would plot a truncated number, it is dropped instead
+                if (!mLine.empty() && !mLineOverflow) { parseLine(mLine); }
+                mLine.clear();
+                mLineOverflow = false;
+            } else if (mLine.size() < mLine.capacity()) {
+                mLine.push_back(static_cast<char>(c));
+            } else {
+                mLineOverflow = true;
+            }
+        }
+    }
+
+    // Keyed values are always plotted. Unnamed values only when the whole line is
+    // values, numbers between the words of a log message are not telemetry.
+    void parseLine(std::string_view line) {
+
+        bool plainValues = true;
+        forEachField(line, [&](std::string_view key, const bool numeric, double) {
+            if (key.empty() && !numeric) { plainValues = false; }
+        });
+
+        size_t column = 0;
+        forEachField(line, [&](std::string_view key, const bool numeric, const double value) {
+            if (!numeric) return;
+            // nan and inf, which printf emits for broken sensor values, keep their column but are not plotted
+            if ((!key.empty() || plainValues) && std::isfinite(value)) {
+                if (Series* series = findSeries(key, column); series != nullptr) { series->push_back(value); }
+            }
+            column++;
+        });
+
+    }
+
+    Element getView() {
+
+        if (mSeries.empty()) {
+            return text("waiting for numeric telemetry ...") | center | flex | border;
+        }
+
+        Elements legend;
+        for (const auto& series : mSeries) {
+            legend.push_back(text(std::format("{}={:.4g} ", series->name, series->samples.back())) | color(series->color));
+        }
+
+        return vbox({
+            hbox(std::move(legend)),
+            separator(),
+            canvas([this](Canvas& c) { draw(c); }) | flex,
+        }) | border;
+
+    }
+
+private:
+
+    struct Extent {
+        double lo = std::numeric_limits<double>::max();
+        double hi = std::numeric_limits<double>::lowest();
+    };
+
+    static Extent merge(const Extent& a, const Extent& b) { return Extent{ std::min(a.lo, b.lo), std::max(a.hi, b.hi) }; }
+
+    // Samples plus a min/max tree over the buffer slots, updated on every push_back, so
+    // the extent of any range of samples costs O(log MAX_SAMPLES) instead of a scan.
+    struct Series {
+        std::string name;
+        Color color;
+        CircularBuffer<double, MAX_SAMPLES> samples;
+        std::array<Extent, 2 * MAX_SAMPLES> extents;    // leaves at MAX_SAMPLES + slot
+        size_t written = 0;
+
+        void push_back(const double value) {
+            samples.push_back(value);
+            size_t node = written++ % MAX_SAMPLES + MAX_SAMPLES;
+            extents[node] = Extent{ value, value };
+            for (node /= 2; node > 0; node /= 2) { extents[node] = merge(extents[2 * node], extents[2 * node + 1]); }
+        }
+
+        // min/max of the samples [first, last), 0 is the oldest
+        Extent extent(const size_t first, const size_t last) const {
+            const size_t start = (written - samples.size() + first) % MAX_SAMPLES;
+            const size_t count = last - first;
+            if (start + count <= MAX_SAMPLES) return slots(start, start + count);
+            return merge(slots(start, MAX_SAMPLES), slots(0, start + count - MAX_SAMPLES));
+        }
+
+        Extent slots(size_t first, size_t last) const {
+            Extent e;
+            for (first += MAX_SAMPLES, last += MAX_SAMPLES; first < last; first /= 2, last /= 2) {
+                if (first & 1) { e = merge(e, extents[first++]); }
+                if (last & 1)  { e = merge(e, extents[--last]); }
+            }
+            return e;
+        }
+    };
+
+    static constexpr std::string_view sSeparators = ",; \t";
+    static constexpr std::array<Color::Palette16, MAX_SERIES> sColors = {
+        Color::Green, Color::Yellow, Color::Cyan, Color::Magenta,
+        Color::Red, Color::Blue, Color::White, Color::GrayLight
+    };
+
+    bool mEnableView = false;
+    std::string mLine;
+    bool mLineOverflow = false;
+    std::vector<std::unique_ptr<Series>> mSeries;
+
+    // Calls fn(key, numeric, value) for every field, numeric when the whole value parsed as a number.
+    template<typename Fn>
+    static void forEachField(std::string_view line, Fn&& fn) {
+
+        while (!line.empty()) {
+
+            const auto end = line.find_first_of(sSeparators);
+            std::string_view field = line.substr(0, end);
+            line = (end == std::string_view::npos) ? std::string_view() : line.substr(end + 1);
+
+            if (field.empty()) continue;
+
+            std::string_view key;
+            if (const auto split = field.find_first_of("=:"); split != std::string_view::npos) {
+                key = field.substr(0, split);
+                field = field.substr(split + 1);
+            }
+
+            double value = 0;
+            const auto [ptr, ec] = std::from_chars(field.data(), field.data() + field.size(), value);
+            fn(key, ec == std::errc() && ptr == field.data() + field.size(), value);
+        }
+
+    }
+
+    Series* findSeries(std::string_view key, const size_t column) {
+
+        // unnamed values get a synthetic colN key, so they never share a trace with a keyed series
+        std::array<char, 24> columnKey;
+        if (key.empty()) {
+            const auto result = std::format_to_n(columnKey.data(), columnKey.size(), "col{}", column);
+            key = std::string_view(columnKey.data(), result.out);
+        }
+
+        for (auto& series : mSeries) {
+            if (series->name == key) return series.get();
+        }
+        return addSeries(std::string(key));
+    }
+
+    Series* addSeries(std::string name) {
+        if (mSeries.size() == MAX_SERIES) return nullptr;
+        mSeries.push_back(std::make_unique<Series>());
+        mSeries.back()->name = std::move(name);
+        mSeries.back()->color = sColors[mSeries.size() - 1];
+        return mSeries.back().get();
+    }
+
+    // Each pixel column draws the min/max of the samples that fall into it, taken from the
+    // extent tree, so the work depends on the canvas width and not on the sample count.
+    void draw(Canvas& c) {
+
+        const int width = c.width();
+        const int height = c.height();
+        if (width < 2 || height < 2) return;
+
+        Extent range;
+        for (const auto& series : mSeries) {
+            range = merge(range, series->extent(0, series->samples.size()));
+        }
+        const double lo = range.lo;
+        const double hi = (range.hi <= range.lo) ? range.lo + 1.0 : range.hi;
+
+        const auto toY = [&](const double v) {
+            return static_cast<int>((hi - v) / (hi - lo) * (height - 1));
+        };
+
+        for (const auto& series : mSeries) {
+
+            const size_t n = series->samples.size();
+            if (n == 0) continue;
+
+            int lastY = -1;
+            for (int x = 0; x < width; x++) {
+
+                const size_t begin = static_cast<size_t>(x) * n / width;
+                const size_t end = std::min(std::max(begin + 1, static_cast<size_t>(x + 1) * n / width), n);
+                if (begin >= n) break;
+
+                const Extent column = series->extent(begin, end);
+                const int firstY = toY(series->samples[begin]);
+                if (lastY >= 0) { c.DrawPointLine(x - 1, lastY, x, firstY, series->color); }
+                c.DrawPointLine(x, toY(column.hi), x, toY(column.lo), series->color);
+                lastY = toY(series->samples[end - 1]);
+            }
+        }
+
+    }
+
+};
+
+#endif // PLOT_VIEW_H
@@ -0,0 +1,200 @@
+#ifndef PORT_WATCHER_H
+#define PORT_WATCHER_H
+
+#define NOMINMAX 1
+#define WIN32_LEAN_AND_MEAN
+#include "Windows.h"
+#include <initguid.h>
+#include <devguid.h>
+#include <setupapi.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <format>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct PortInfo {
+    std::string name;
+    std::string description;
+    uint16_t vid = 0;
+    uint16_t pid = 0;
+
+    std::string label() const {
+        if (vid != 0 || pid != 0) { return std::format("{} [{:04X}:{:04X}] {}", name, vid, pid, description); }
+        if (!description.empty()) { return std::format("{} {}", name, description); }
+        return name;
+    }
+
+    bool operator==(const PortInfo&) const = default;
+};
+
+// Keeps the list of serial ports up to date on a background thread. The SERIALCOMM
+// registry key is the list windows itself maintains for present ports, so waiting on
+// change notifications for it catches hot plugging without polling every COM name.
+// Device details are only queried from SetupAPI when the list changed.
+class PortWatcher {
+public:
+
+    PortWatcher() { }
+
+    ~PortWatcher() { stop(); }
+
+    void start() {
+        if (mThread.joinable()) return;
+        mStopEvent = CreateEvent(nullptr, TRUE, FALSE, nullptr);
+        mThread = std::thread([this]() { run(); });
+    }
+
+    void stop() {
+        if (!mThread.joinable()) return;
+        SetEvent(mStopEvent);
+        mThread.join();
+        CloseHandle(mStopEvent);
+    }
+
+    // Copies the port list only when it changed since the last call, never waits on
+    // the enumeration itself.
+    bool update(std::vector<PortInfo>& ports) {
+        std::scoped_lock<std::mutex> lock(mMutex);
+        if (mGeneration == mSeenGeneration) return false;
+        mSeenGeneration = mGeneration;
+        ports = mPorts;
+        return true;
+    }
+
+    bool isPresent(const std::string& name) const {
+        std::scoped_lock<std::mutex> lock(mMutex);
+        return std::ranges::any_of(mPorts, [&](const PortInfo& port) { return port.name == name; });
+    }
+
+private:
+
+    static constexpr DWORD RETRY_OPEN_KEY_MS = 1000;
+
+    mutable std::mutex mMutex;
+    std::thread mThread;
+    HANDLE mStopEvent = nullptr;
+    std::vector<PortInfo> mPorts;
+    uint64_t mGeneration = 0;
+    uint64_t mSeenGeneration = 0;
+
+    void run() {
+
+        HKEY key = nullptr;
+        HANDLE changed = CreateEvent(nullptr, FALSE, FALSE, nullptr);
+        std::vector<std::string> names;
+        bool first = true;
+
+        while (true) {
+
+            // the key only exists while at least one port is present
+            if (key == nullptr && RegOpenKeyEx(HKEY_LOCAL_MACHINE, "HARDWARE\\DEVICEMAP\\SERIALCOMM", 0, KEY_READ | KEY_NOTIFY, &key) != ERROR_SUCCESS) {
+                key = nullptr;
+            }
+
+            if (key != nullptr && RegNotifyChangeKeyValue(key, FALSE, REG_NOTIFY_CHANGE_LAST_SET, changed, TRUE) != ERROR_SUCCESS) {
+                RegCloseKey(key);
+                key = nullptr;
+            }
+
+            auto current = readPortNames(key);
+            if (current != names || first) {
+                names = std::move(current);
+                publish(describePorts(names));
+                first = false;
+            }
+
+            HANDLE handles[] = { mStopEvent, changed };
+            if (WaitForMultipleObjects(2, handles, FALSE, (key == nullptr) ? RETRY_OPEN_KEY_MS : INFINITE) == WAIT_OBJECT_0) break;
+        }
+
+        if (key != nullptr) { RegCloseKey(key); }
+        CloseHandle(changed);
+    }
+
+    void publish(std::vector<PortInfo> ports) {
+        std::scoped_lock<std::mutex> lock(mMutex);
+        mPorts = std::move(ports);
+        mGeneration++;
+    }
+
+    static std::vector<std::string> readPortNames(HKEY key) {
+
+        std::vector<std::string> names;
+        if (key == nullptr) return names;
+
+        char valueName[256];
+        char data[256];
+        for (DWORD i = 0;; i++) {
+            DWORD valueNameSize = sizeof(valueName);
+            DWORD dataSize = sizeof(data) - 1;
+            DWORD type = 0;
+            const auto result = RegEnumValue(key, i, valueName, &valueNameSize, nullptr, &type, reinterpret_cast<BYTE*>(data), &dataSize);
+            if (result == ERROR_NO_MORE_ITEMS) break;
+            if (result != ERROR_SUCCESS || type != REG_SZ) continue;
+            data[dataSize] = '\0';
+            names.emplace_back(data);
+        }
+
+        // COM2 before COM10
+        std::ranges::sort(names, [](const std::string& a, const std::string& b) {
+            return (a.size() != b.size()) ? a.size() < b.size() : a < b;
+        });
+        return names;
+    }
+
+    static std::vector<PortInfo> describePorts(const std::vector<std::string>& names) {
+
+        std::vector<PortInfo> ports;
+        for (const auto& name : names) { ports.push_back(PortInfo{ .name = name }); }
+
+        HDEVINFO devices = SetupDiGetClassDevs(&GUID_DEVCLASS_PORTS, nullptr, nullptr, DIGCF_PRESENT);
+        if (devices == INVALID_HANDLE_VALUE) return ports;
+
+        SP_DEVINFO_DATA device = { .cbSize = sizeof(SP_DEVINFO_DATA) };
+        for (DWORD i = 0; SetupDiEnumDeviceInfo(devices, i, &device); i++) {
+
+            HKEY deviceKey = SetupDiOpenDevRegKey(devices, &device, DICS_FLAG_GLOBAL, 0, DIREG_DEV, KEY_READ);
+            if (deviceKey == INVALID_HANDLE_VALUE) continue;
+
+            char portName[64] = {0};
+            DWORD portNameSize = sizeof(portName) - 1;
+            const auto result = RegQueryValueEx(deviceKey, "PortName", nullptr, nullptr, reinterpret_cast<BYTE*>(portName), &portNameSize);
+            RegCloseKey(deviceKey);
+            if (result != ERROR_SUCCESS) continue;
+
+            auto port = std::ranges::find_if(ports, [&](const PortInfo& p) { return p.name == portName; });
+            if (port == ports.end()) continue;
+
+            char property[512] = {0};
+            if (SetupDiGetDeviceRegistryProperty(devices, &device, SPDRP_FRIENDLYNAME, nullptr, reinterpret_cast<BYTE*>(property), sizeof(property) - 1, nullptr)) {
+                port->description = property;
+            }
+
+            // USB\VID_0403&PID_6001&REV_0600
+            if (SetupDiGetDeviceRegistryProperty(devices, &device, SPDRP_HARDWAREID, nullptr, reinterpret_cast<BYTE*>(property), sizeof(property) - 1, nullptr)) {
+                const std::string hardwareId(property);
+                const auto vid = hardwareId.find("VID_");
+                const auto pid = hardwareId.find("PID_");
+                if (vid != std::string::npos && pid != std::string::npos) {
+                    unsigned int v = 0;
+                    unsigned int p = 0;
+                    std::sscanf(hardwareId.c_str() + vid, "VID_%4x", &v);
+                    std::sscanf(hardwareId.c_str() + pid, "PID_%4x", &p);
+                    port->vid = static_cast<uint16_t>(v);
+                    port->pid = static_cast<uint16_t>(p);
+                }
+            }
+        }
+
+        SetupDiDestroyDeviceInfoList(devices);
+        return ports;
+    }
+
+};
+
+#endif // PORT_WATCHER_H
@@ -1,22 +1,30 @@
+
 #ifndef PREVIOUS_COMMANDS_VIEW
 #define PREVIOUS_COMMANDS_VIEW
 
 #include <algorithm>
+#include <cctype>
 #include <ftxui/component/component_base.hpp>
 #include <ftxui/dom/elements.hpp>
+#include <filesystem>
+#include <format>
 #include <vector>
 #include <string>
+#include <string_view>
 #include "ftxui/component/component.hpp"
+#include "CommandHistory.hpp"
 
 using namespace ftxui;
 
 class PreviousCommandsView {
 public:
 
+    void load(const std::filesystem::path& journalFile, const std::filesystem::path& legacyFile) {
+        mHistory.load(journalFile, legacyFile);
+    }
+
     void addToHistory(const std::string& str) {
-        if (std::find(mPreviousCommands.begin(), mPreviousCommands.end(), str) == mPreviousCommands.end()) {
-            mPreviousCommands.push_back(str);
-        };
+        mHistory.add(str);
     }
 
     void toggleView() {
@@ -26,37 +34,122 @@ public:
     bool enabled() const { return mEnableView; }
 
     Element getView() {
-        return window(text("Send History"), mHistoryComponent->Render()) | clear_under;
+        refresh();
+        const std::string title = (mFiltering || !mQuery.empty())
+            ? std::format("Send History /{}{} ({}/{})", mQuery, mFiltering ? "_" : "", mMatches.size(), mHistory.size())
+            : "Send History";
+        return window(text(title), mHistoryComponent->Render()) | clear_under;
     }
 
     void removeFromHistory() {
-        if (mPreviousCommands.empty()) return;
-        mPreviousCommands.erase(mPreviousCommands.begin() + mSelectionIdx);
-        if (mSelectionIdx > mPreviousCommands.size()) {
-            mSelectionIdx--;
-        }
+        refresh();
+        if (mVisibleCommands.empty()) return;
+        mHistory.remove(mVisibleCommands.at(mSelectionIdx));
+        refresh();
     }
 
-    std::string getSendFromHistory() { 
-        if (mPreviousCommands.empty()) return "";
-        return mPreviousCommands.at(mSelectionIdx); }
+    std::string getSendFromHistory() {
+        refresh();
+        if (mVisibleCommands.empty()) return "";
+        return mVisibleCommands.at(mSelectionIdx); }
 
     bool OnEvent(Event event) {
+        refresh();
         return mHistoryComponent->OnEvent(event);
     }
 
-    std::vector<std::string> getCommandHistory() {
-        return mPreviousCommands;    
+    bool filtering() const { return mFiltering; }
+
+    void startFilter() { mFiltering = true; }
+
+    void stopFilter() { mFiltering = false; }
+
+    // Called when the view is dismissed, it opens unfiltered next time.
+    void clearFilter() {
+        mFiltering = false;
+        if (mQuery.empty()) return;
+        mQuery.clear();
+        mSelectionIdx = 0;
+        mMatchedRevision = INVALID_REVISION;
+    }
+
+    // Typing while filtering narrows the query, a query that only grew is matched
+    // against the previous matches instead of the whole history.
+    bool OnFilterEvent(Event event) {
+
+        if (event == Event::Return) {
+            mFiltering = false;
+        } else if (event == Event::Backspace) {
+            if (mQuery.empty()) { mFiltering = false; return true; }
+            mQuery.pop_back();
+            mMatchedRevision = INVALID_REVISION;
+        } else if (event.is_character()) {
+            mQuery += event.character();
+            mNarrowOnly = true;
+        } else {
+            return false;
+        }
+
+        mSelectionIdx = 0;
+        refresh();
+        return true;
     }
 
 private:
 
+    static constexpr size_t MAX_VISIBLE_COMMANDS = 256;
+    static constexpr size_t INVALID_REVISION = static_cast<size_t>(-1);
+
     bool mEnableView = false;
-    std::vector<std::string> mPreviousCommands;
+    CommandHistory mHistory;
     int mSelectionIdx = 0;
 
-    Component mHistoryComponent = Menu(&mPreviousCommands, &mSelectionIdx);
-    
+    bool mFiltering = false;
+    bool mNarrowOnly = false;
+    std::string mQuery;
+    std::vector<const std::string*> mMatches;
+    size_t mMatchedRevision = INVALID_REVISION;
+    std::vector<std::string> mVisibleCommands;
+
+    Component mHistoryComponent = Menu(&mVisibleCommands, &mSelectionIdx);
+
+    // case insensitive subsequence match
+    static bool fuzzyMatch(std::string_view query, std::string_view candidate) {
+        auto it = candidate.begin();
+        for (const char q : query) {
+            const auto lower = std::tolower(static_cast<unsigned char>(q));
+            it = std::find_if(it, candidate.end(), [&](const char c) { return std::tolower(static_cast<unsigned char>(c)) == lower; });
+            if (it == candidate.end()) return false;
+            it++;
+        }
+        return true;
+    }
+
+    void refresh() {
+
+        if (mMatchedRevision == mHistory.revision() && !mNarrowOnly) return;
+
+        if (mNarrowOnly && mMatchedRevision == mHistory.revision()) {
+            std::erase_if(mMatches, [&](const std::string* cmd) { return !fuzzyMatch(mQuery, *cmd); });
+        } else {
+            mMatches.clear();
+            for (const auto& cmd : mHistory.entries()) {
+                if (fuzzyMatch(mQuery, cmd)) { mMatches.push_back(&cmd); }
+            }
+        }
+
+        mNarrowOnly = false;
+        mMatchedRevision = mHistory.revision();
+
+        // the menu only ever shows a screenful, the full match list stays as pointers
+        mVisibleCommands.clear();
+        for (size_t i = 0; i < std::min(mMatches.size(), MAX_VISIBLE_COMMANDS); i++) {
+            mVisibleCommands.push_back(*mMatches[i]);
+        }
+
+        mSelectionIdx = std::clamp(mSelectionIdx, 0, std::max(static_cast<int>(mVisibleCommands.size()) - 1, 0));
+    }
+
 };
 
 #endif // PREVIOUS_COMMANDS_VIEW
@@ -0,0 +1,350 @@
+#ifndef SCROLLBACK_H
+#define SCROLLBACK_H
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "lz4.h"
+#include "AnsiParser.hpp"
+
+struct SerialData {
+    bool rxtx = false;
+    std::string text;
+    std::chrono::time_point<std::chrono::utc_clock> time;
+    bool frame = false;
+    bool crcError = false;
+    std::vector<StyleRun> styles;
+    uint16_t columns = 0;
+    std::string raw;    // received bytes, only kept when escaping or ANSI made them differ from text
+};
+
+struct ScrollbackStats {
+    size_t rows = 0;
+    size_t pages = 0;
+    size_t compressedPages = 0;
+    size_t residentBytes = 0;       // what the scrollback currently holds in memory
+    size_t budgetBytes = 0;
+    double compressionRatio = 1.0;  // raw / compressed size of the cold pages
+};
+
+// Row storage for AsciiView. Rows are grouped into fixed size pages, the open page and
+// the most recent HOT_PAGES sealed pages stay as SerialData, older pages are compressed
+// with LZ4 by a background thread. Reading a cold page decompresses it into a small LRU.
+// Once the memory budget is exceeded the oldest pages are dropped.
+class Scrollback {
+public:
+
+    static constexpr size_t ROWS_PER_PAGE  = 1024;
+    static constexpr size_t HOT_PAGES      = 4;
+    static constexpr size_t DECODED_PAGES  = 4;
+    static constexpr size_t DEFAULT_BUDGET = 256 * 1024 * 1024;
+
+    using Rows = std::vector<SerialData>;
+
+    Scrollback() { mCompressor = std::thread([this]() { compressLoop(); }); }
+
+    ~Scrollback() {
+        {
+            std::scoped_lock<std::mutex> lock(mMutex);
+            mRunning = false;
+        }
+        mCondition.notify_one();
+        mCompressor.join();
+    }
+
+    size_t size() const { return mSealedRows + mTail.size(); }
+
+    bool empty() const { return size() == 0; }
+
+    // the last row always lives in the open page
+    SerialData& back() { return mTail.back(); }
+
+    void push_back(SerialData&& row) {
+        mTail.push_back(std::move(row));
+        if (mTail.size() > ROWS_PER_PAGE) { seal(); }
+    }
+
+    template<typename... Args>
+    SerialData& emplace_back(Args&&... args) {
+        push_back(SerialData(std::forward<Args>(args)...));
+        return mTail.back();
+    }
+
+    void clear() {
+        std::scoped_lock<std::mutex> lock(mMutex);
+        mPages.clear();
+        mTail.clear();
+        mDecoded.clear();
+        mSealedRows = 0;
+        mResidentBytes = 0;
+        mColdRawBytes = 0;
+        mColdBytes = 0;
+    }
+
+    void setMemoryBudget(const size_t bytes) { mBudgetBytes = bytes; }
+
+    // Rows dropped from the front since the last call, lets the view keep its position.
+    size_t takeDroppedRows() { return std::exchange(mDroppedRows, 0); }
+
+    // Calls fn for each row in [first, last), decompressing cold pages as needed.
+    template<typename F>
+    void visit(size_t first, size_t last, F&& fn) {
+
+        last = std::min(last, size());
+
+        for (size_t i = first; i < last;) {
+
+            if (i >= mSealedRows) {
+                fn(mTail[i - mSealedRows]);
+                i++;
+                continue;
+            }
+
+            const auto rows = pageRows(i / ROWS_PER_PAGE);
+            const size_t pageEnd = std::min(last, (i / ROWS_PER_PAGE + 1) * ROWS_PER_PAGE);
+            for (; i < pageEnd; i++) { fn((*rows)[i % ROWS_PER_PAGE]); }
+        }
+
+    }
+
+    ScrollbackStats getStats() const {
+        std::scoped_lock<std::mutex> lock(mMutex);
+        size_t decodedBytes = 0;
+        for (const auto& decoded : mDecoded) { decodedBytes += decoded.bytes; }
+        return ScrollbackStats{
+            .rows = size(),
+            .pages = mPages.size(),
+            .compressedPages = static_cast<size_t>(std::ranges::count_if(mPages, [](const Page& p) { return p.rows == nullptr; })),
+            .residentBytes = mResidentBytes + decodedBytes,
+            .budgetBytes = mBudgetBytes,
+            .compressionRatio = (mColdBytes > 0) ? static_cast<double>(mColdRawBytes) / mColdBytes : 1.0
+        };
+    }
+
+    // A consistent view of the sealed pages for readers on other threads, the pages
+    // themselves are immutable so only the handles are copied.
+    struct PageRef {
+        std::shared_ptr<const Rows> rows;
+        std::shared_ptr<const std::vector<char>> compressed;
+        size_t rawSize = 0;
+    };
+
+    std::vector<PageRef> snapshotPages() const {
+        std::scoped_lock<std::mutex> lock(mMutex);
+        std::vector<PageRef> pages;
+        pages.reserve(mPages.size());
+        for (const auto& page : mPages) { pages.push_back(PageRef{ page.rows, page.compressed, page.rawSize }); }
+        return pages;
+    }
+
+    Rows copyTail() const { return mTail; }
+
+    static std::shared_ptr<const Rows> decompress(const PageRef& page) {
+        if (page.rows) return page.rows;
+        std::vector<char> raw(page.rawSize);
+        LZ4_decompress_safe(page.compressed->data(), raw.data(), static_cast<int>(page.compressed->size()), static_cast<int>(raw.size()));
+        return std::make_shared<const Rows>(deserialize(raw));
+    }
+
+private:
+
+    struct Page {
+        uint64_t id = 0;
+        std::shared_ptr<const Rows> rows;
+        std::shared_ptr<const std::vector<char>> compressed;
+        size_t rawSize = 0;     // serialized size, needed to decompress
+        size_t bytes = 0;       // resident size of whichever representation is held
+    };
+
+    struct DecodedPage {
+        uint64_t id = 0;
+        std::shared_ptr<const Rows> rows;
+        size_t bytes = 0;
+    };
+
+    mutable std::mutex mMutex;
+    std::condition_variable mCondition;
+    std::thread mCompressor;
+    bool mRunning = true;
+
+    std::deque<Page> mPages;
+    Rows mTail;
+    std::list<DecodedPage> mDecoded;
+    uint64_t mNextPageId = 0;
+    size_t mSealedRows = 0;
+    size_t mDroppedRows = 0;
+
+    size_t mBudgetBytes = DEFAULT_BUDGET;
+    size_t mResidentBytes = 0;
+    size_t mColdRawBytes = 0;
+    size_t mColdBytes = 0;
+
+    static size_t rowBytes(const SerialData& row) {
+        return sizeof(SerialData) + row.text.capacity() + row.raw.capacity() + row.styles.capacity() * sizeof(StyleRun);
+    }
+
+    void seal() {
+
+        auto rows = std::make_shared<Rows>(std::make_move_iterator(mTail.begin()), std::make_move_iterator(mTail.begin() + ROWS_PER_PAGE));
+        mTail.erase(mTail.begin(), mTail.begin() + ROWS_PER_PAGE);
+
+        size_t bytes = 0;
+        for (const auto& row : *rows) { bytes += rowBytes(row); }
+
+        {
+            std::scoped_lock<std::mutex> lock(mMutex);
+            mPages.push_back(Page{ .id = mNextPageId++, .rows = std::move(rows), .bytes = bytes });
+            mSealedRows += ROWS_PER_PAGE;
+            mResidentBytes += bytes;
+
+            while (mResidentBytes > mBudgetBytes && mPages.size() > HOT_PAGES) {
+                const auto& front = mPages.front();
+                mResidentBytes -= front.bytes;
+                if (!front.rows) { mColdRawBytes -= front.rawSize; mColdBytes -= front.bytes; }
+                std::erase_if(mDecoded, [&](const DecodedPage& d) { return d.id == front.id; });
+                mPages.pop_front();
+                mSealedRows -= ROWS_PER_PAGE;
+                mDroppedRows += ROWS_PER_PAGE;
+            }
+        }
+
+        mCondition.notify_one();
+    }
+
+    std::shared_ptr<const Rows> pageRows(const size_t pageIndex) {
+
+        PageRef ref;
+        uint64_t id = 0;
+        {
+            std::scoped_lock<std::mutex> lock(mMutex);
+            const auto& page = mPages[pageIndex];
+            if (page.rows) return page.rows;
+
+            id = page.id;
+            if (const auto it = std::ranges::find_if(mDecoded, [&](const DecodedPage& d) { return d.id == id; }); it != mDecoded.end()) {
+                mDecoded.splice(mDecoded.begin(), mDecoded, it);
+                return it->rows;
+            }
+            ref = PageRef{ page.rows, page.compressed, page.rawSize };
+        }
+
+        auto rows = decompress(ref);
+
+        std::scoped_lock<std::mutex> lock(mMutex);
+        mDecoded.push_front(DecodedPage{ .id = id, .rows = rows, .bytes = ref.rawSize });
+        if (mDecoded.size() > DECODED_PAGES) { mDecoded.pop_back(); }
+        return rows;
+    }
+
+    void compressLoop() {
+
+        std::unique_lock<std::mutex> lock(mMutex);
+        while (mRunning) {
+
+            const auto cold = [this]() {
+                return std::ranges::find_if(mPages.begin(), mPages.end() - std::min(mPages.size(), HOT_PAGES), [](const Page& p) { return p.rows != nullptr; });
+            };
+
+            mCondition.wait(lock, [&]() { return !mRunning || cold() != mPages.end() - std::min(mPages.size(), HOT_PAGES); });
+            if (!mRunning) break;
+
+            const Page page = *cold();
+            lock.unlock();
+
+            std::vector<char> raw;
+            serialize(*page.rows, raw);
+            auto compressed = std::make_shared<std::vector<char>>(LZ4_compressBound(static_cast<int>(raw.size())));
+            const int compressedSize = LZ4_compress_default(raw.data(), compressed->data(), static_cast<int>(raw.size()), static_cast<int>(compressed->size()));
+            compressed->resize(std::max(compressedSize, 0));
+            compressed->shrink_to_fit();
+
+            lock.lock();
+
+            // the page may have been dropped or cleared while compressing
+            const auto it = std::ranges::find_if(mPages, [&](const Page& p) { return p.id == page.id; });
+            if (it == mPages.end() || compressedSize <= 0) continue;
+
+            mResidentBytes = mResidentBytes - it->bytes + compressed->size();
+            mColdRawBytes += raw.size();
+            mColdBytes += compressed->size();
+            it->bytes = compressed->size();
+            it->rawSize = raw.size();
+            it->compressed = std::move(compressed);
+            it->rows.reset();
+        }
+
+    }
+
+    template<typename T>
+    static void put(std::vector<char>& out, const T& value) {
+        const auto* bytes = reinterpret_cast<const char*>(&value);
+        out.insert(out.end(), bytes, bytes + sizeof(T));
+    }
+
+    template<typename T>
+    static T get(const char*& in) {
+        T value;
+        std::memcpy(&value, in, sizeof(T));
+        in += sizeof(T);
+        return value;
+    }
+
+    static void serialize(const Rows& rows, std::vector<char>& out) {
+        for (const auto& row : rows) {
+            put<uint8_t>(out, static_cast<uint8_t>(row.rxtx | (row.frame << 1) | (row.crcError << 2)));
+            put(out, row.time.time_since_epoch().count());
+            put(out, row.columns);
+            put(out, static_cast<uint32_t>(row.text.size()));
+            out.insert(out.end(), row.text.begin(), row.text.end());
+            put(out, static_cast<uint16_t>(row.styles.size()));
+            for (const auto& style : row.styles) { put(out, style); }
+            put(out, static_cast<uint32_t>(row.raw.size()));
+            out.insert(out.end(), row.raw.begin(), row.raw.end());
+        }
+    }
+
+    static Rows deserialize(const std::vector<char>& raw) {
+
+        using Duration = std::chrono::utc_clock::duration;
+
+        Rows rows;
+        rows.reserve(ROWS_PER_PAGE);
+
+        const char* in = raw.data();
+        const char* end = raw.data() + raw.size();
+        while (in < end) {
+            SerialData row;
+            const auto flags = get<uint8_t>(in);
+            row.rxtx = flags & 1;
+            row.frame = flags & 2;
+            row.crcError = flags & 4;
+            row.time = std::chrono::time_point<std::chrono::utc_clock>(Duration(get<Duration::rep>(in)));
+            row.columns = get<uint16_t>(in);
+            const auto length = get<uint32_t>(in);
+            row.text.assign(in, length);
+            in += length;
+            row.styles.resize(get<uint16_t>(in));
+            for (auto& style : row.styles) { style = get<StyleRun>(in); }
+            const auto rawLength = get<uint32_t>(in);
+            row.raw.assign(in, rawLength);
+            in += rawLength;
+            rows.push_back(std::move(row));
+        }
+        return rows;
+    }
+
+};
+
+#endif // SCROLLBACK_H
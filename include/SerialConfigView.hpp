@@ -4,6 +4,8 @@
 #include "ftxui/dom/elements.hpp"
 #include "ftxui/component/component.hpp"
 #include "serial_windows.hpp"
+#include "PortWatcher.hpp"
+#include "BaudDetector.hpp"
 #include <ftxui/component/component_options.hpp>
 #include <ftxui/dom/node.hpp>
 
@@ -12,30 +14,82 @@
 using namespace ftxui;
     
 static std::vector<std::string> availableComPorts;
+static std::vector<std::string> availableComPortLabels;
 static const std::vector<std::string> availableBaudrates  = {"115200", "921600", "9600", "19200", "38400", "57600", "230400", "460800"};
 static const std::vector<std::string> dataBits            = {"8 Data Bits", "7 Data Bits"};
 static const std::vector<std::string> stopBits            = {"1 Stop Bits", "1.5 Stop Bits", "2 Stop Bits"};
 static const std::vector<std::string> parityStrings       = {"None", "Odd", "Even", "Mark", "Space"};
+static const std::vector<std::string> flowControlStrings  = {"No Flow Control", "RTS/CTS", "XON/XOFF"};
+static const std::vector<std::string> rxQueueStrings      = {"Default RX Queue", "4 KB RX Queue", "16 KB RX Queue", "64 KB RX Queue", "256 KB RX Queue"};
+static const std::vector<std::string> txQueueStrings      = {"Default TX Queue", "4 KB TX Queue", "16 KB TX Queue", "64 KB TX Queue", "256 KB TX Queue"};
+static const std::vector<uint32_t>    queueSizes          = {0, 4096, 16384, 65536, 262144};
 
 class SerialConfigView {
 public:
 
-    SerialConfigView(Serial& serial) : mSerial(serial) { }
+    SerialConfigView(Serial& serial) : mSerial(serial), mBaudDetector(mDetectPort) { }
 
     ~SerialConfigView() { }
     
     Element getView() {
-        return window(text("Port Configuration"), mPortConfigurationComponent->Render()) | clear_under;
+        const std::string detectStatus = mBaudDetector.getStatus();
+        return window(text("Port Configuration"),
+            vbox({
+                mPortConfigurationComponent->Render(),
+                detectStatus.empty() ? emptyElement() : text(detectStatus) | color(mBaudDetector.running() ? Color::Yellow : Color::GrayLight)
+            })
+        ) | clear_under;
+    }
+
+    // Polled by the ui thread, applies the detected settings once the detector finished.
+    bool pollAutoDetect() {
+
+        const auto result = mBaudDetector.takeResult();
+        if (!result) return mBaudDetector.running();
+
+        const LineSettings settings = result->found ? result->settings : mDetectFallback;
+
+        auto it = std::find(availableBaudrates.begin(), availableBaudrates.end(), std::to_string(settings.baudrate));
+        if (it != availableBaudrates.end()) { mBaudrateSelected = std::distance(availableBaudrates.begin(), it); }
+        mDataBitsSelected = Serial::DataBits::EIGHT - settings.dataBits;
+        mParitySelected = settings.parity;
+        mStopBitsSelected = settings.stopBits;
+
+        applyConfig();
+        return true;
+    }
+
+    // Called by the ui thread whenever the PortWatcher reports a change, the selection
+    // stays on the same port name if it is still present.
+    void setAvailableComPorts(const std::vector<PortInfo>& ports) {
+
+        const std::string selected = (mPortSelected < static_cast<int>(availableComPorts.size())) ? availableComPorts[mPortSelected] : mSerial.getPortName();
+
+        availableComPorts.clear();
+        availableComPortLabels.clear();
+        for (const auto& port : ports) {
+            availableComPorts.push_back(port.name);
+            availableComPortLabels.push_back(port.label());
+        }
+
+        const auto it = std::find(availableComPorts.cbegin(), availableComPorts.cend(), selected);
+        mPortSelected = (it != availableComPorts.cend()) ? std::distance(availableComPorts.cbegin(), it) : 0;
+
     }
 
     void listAvailableComPorts(const Serial& serial) {
         
-        availableComPorts = Serial::enumerateComPorts();
         auto it = std::find(availableComPorts.cbegin(), availableComPorts.cend(), serial.getPortName());
         if (it != availableComPorts.end()) { mPortSelected = std::distance(availableComPorts.cbegin(), it); }
 
         it = std::find(availableBaudrates.begin(), availableBaudrates.end(), std::to_string(serial.getBaudrate()));
         if (it != availableBaudrates.end()) { mBaudrateSelected = std::distance(availableBaudrates.begin(), it); }
+
+        mFlowControlSelected = static_cast<int>(serial.getFlowControl());
+        auto size = std::find(queueSizes.begin(), queueSizes.end(), serial.getRxQueueSize());
+        if (size != queueSizes.end()) { mRxQueueSelected = std::distance(queueSizes.begin(), size); }
+        size = std::find(queueSizes.begin(), queueSizes.end(), serial.getTxQueueSize());
+        if (size != queueSizes.end()) { mTxQueueSelected = std::distance(queueSizes.begin(), size); }
         
     }
 
@@ -48,15 +102,47 @@ private:
     int mDataBitsSelected = 0;
     int mStopBitsSelected = 0;
     int mParitySelected   = 0;
+    int mFlowControlSelected = 0;
+    int mRxQueueSelected  = 0;
+    int mTxQueueSelected  = 0;
 
     Serial& mSerial;
+    Serial mDetectPort;         // the reader thread owns mSerial, detection samples through its own handle
+    BaudDetector mBaudDetector;
+    LineSettings mDetectFallback;
+
+    void applyConfig() {
+        if (mPortSelected >= static_cast<int>(availableComPorts.size())) return;
+        mSerial.setDataBits(static_cast<Serial::DataBits>(Serial::DataBits::EIGHT - mDataBitsSelected));
+        mSerial.setStopBits(static_cast<Serial::StopBits>(mStopBitsSelected));
+        mSerial.setParity(static_cast<Serial::Parity>(mParitySelected));
+        mSerial.setFlowControl(static_cast<Serial::FlowControl>(mFlowControlSelected));
+        mSerial.setQueueSizes(queueSizes[mRxQueueSelected], queueSizes[mTxQueueSelected]);
+        mSerial.open(availableComPorts[mPortSelected],
+                    std::stoi(availableBaudrates[mBaudrateSelected]));
+    }
+
+    // the port is exclusive, so the detector gets it while the main connection is closed
+    void startAutoDetect() {
+        if (mBaudDetector.running() || mPortSelected >= static_cast<int>(availableComPorts.size())) return;
+
+        mDetectFallback = LineSettings{
+            .baudrate = static_cast<uint32_t>(std::stoi(availableBaudrates[mBaudrateSelected])),
+            .dataBits = static_cast<Serial::DataBits>(Serial::DataBits::EIGHT - mDataBitsSelected),
+            .parity = static_cast<Serial::Parity>(mParitySelected),
+            .stopBits = static_cast<Serial::StopBits>(mStopBitsSelected)
+        };
+
+        std::vector<uint32_t> baudrates;
+        for (const auto& baudrate : availableBaudrates) { baudrates.push_back(std::stoi(baudrate)); }
+
+        mSerial.close();
+        mBaudDetector.start(availableComPorts[mPortSelected], baudrates);
+    }
     
     ButtonOption mButtonOption {
         .label = "Apply",
-        .on_click = [&]() {
-            mSerial.open(availableComPorts[mPortSelected],
-                        std::stoi(availableBaudrates[mBaudrateSelected]));
-        },
+        .on_click = [&]() { applyConfig(); },
         .transform = [](const EntryState& state) -> Element {
             const std::string t = state.focused ? "[" + state.label + "]"  //
                                                 : " " + state.label + " ";
@@ -64,18 +150,30 @@ private:
         }
     };
     
+    ButtonOption mDetectButtonOption {
+        .label = "Auto Detect",
+        .on_click = [&]() { startAutoDetect(); },
+        .transform = mButtonOption.transform
+    };
+    
     Component mPortConfigurationComponent = Container::Vertical({
-        Dropdown(&availableComPorts, &mPortSelected),
+        Dropdown(&availableComPortLabels, &mPortSelected),
         Dropdown(&availableBaudrates, &mBaudrateSelected),
         Collapsible("Advanced Config",
             Container::Vertical({
                 Dropdown(&dataBits, &mDataBitsSelected),
                 Dropdown(&stopBits, &mStopBitsSelected),
                 Dropdown(&parityStrings, &mParitySelected),
+                Dropdown(&flowControlStrings, &mFlowControlSelected),
+                Dropdown(&rxQueueStrings, &mRxQueueSelected),
+                Dropdown(&txQueueStrings, &mTxQueueSelected),
             }),
             false
         ),
-        Button(mButtonOption) | center,
+        Container::Horizontal({
+            Button(mButtonOption),
+            Button(mDetectButtonOption),
+        }) | center,
     });
     
 };
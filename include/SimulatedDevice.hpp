@@ -0,0 +1,177 @@
+#ifndef SIMULATED_DEVICE_H
+#define SIMULATED_DEVICE_H
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <format>
+#include <iterator>
+#include <optional>
+#include <random>
+#include <span>
+#include <string>
+#include <string_view>
+
+enum class SimPattern {
+    Lines,          // text lines as fast as the byte rate allows
+    Binary,         // random binary bursts separated by idle gaps
+    Telemetry,      // key=value records at a fixed period
+    Echo,           // loopback, returns what was sent
+};
+
+struct SimulatorConfig {
+    SimPattern pattern = SimPattern::Lines;
+    uint32_t byteRate = 0;                                  // 0 follows the baud rate
+    uint64_t seed = 1;
+    std::chrono::milliseconds telemetryPeriod{100};
+    std::chrono::milliseconds meanTimeToDisconnect{0};      // 0 never disconnects
+    std::chrono::milliseconds downtime{500};
+};
+
+// In-process stand in for a serial device, driven by Serial::read() instead of a port
+// handle. Output is paced by elapsed time at the configured byte rate, its content and
+// the disconnect schedule only depend on the seed, so runs with the same seed produce
+// the same byte stream.
+class SimulatedDevice {
+public:
+
+    SimulatedDevice(const SimulatorConfig& config) : mConfig(config), mContentRng(config.seed), mScheduleRng(config.seed ^ SCHEDULE_SEED) { }
+
+    ~SimulatedDevice() { }
+
+    static std::optional<SimPattern> parsePattern(std::string_view name) {
+        for (size_t i = 0; i < sPatternNames.size(); i++) {
+            if (name == sPatternNames[i]) return static_cast<SimPattern>(i);
+        }
+        return std::nullopt;
+    }
+
+    static const char* name(const SimPattern pattern) { return sPatternNames[static_cast<int>(pattern)]; }
+
+    void setBaudrate(const uint32_t baudrate) { mBaudrate = baudrate; }
+
+    // Fails while a simulated disconnect lasts, like an unplugged adapter.
+    bool open(const std::chrono::steady_clock::time_point now) {
+        if (now < mAbsentUntil) return false;
+        mLastRead = now;
+        mCredit = 0;
+        scheduleDisconnect(now);
+        return true;
+    }
+
+    // Returns nullopt when the device disconnects.
+    std::optional<size_t> read(std::span<uint8_t> dest, const std::chrono::steady_clock::time_point now) {
+
+        if (mNextDisconnect && now >= *mNextDisconnect) {
+            mNextDisconnect.reset();
+            mAbsentUntil = now + mConfig.downtime;
+            return std::nullopt;
+        }
+
+        // pacing credit is capped so a stalled reader gets at most one second worth at once
+        const double rate = byteRate();
+        mCredit = std::min(mCredit + std::chrono::duration<double>(now - mLastRead).count() * rate, rate);
+        mLastRead = now;
+
+        size_t n = 0;
+        while (n < dest.size() && mCredit >= 1.0) {
+            if (mPendingPos == mPending.size() && !generate(now)) break;
+            const size_t count = std::min({ dest.size() - n, mPending.size() - mPendingPos, static_cast<size_t>(mCredit) });
+            std::copy_n(mPending.begin() + mPendingPos, count, dest.begin() + n);
+            mPendingPos += count;
+            mCredit -= count;
+            n += count;
+        }
+
+        // nothing to send must not bank credit for a burst later
+        if (mPendingPos == mPending.size()) { mCredit = std::min(mCredit, 1.0); }
+        return n;
+    }
+
+    void write(std::span<const uint8_t> data) {
+        if (mConfig.pattern != SimPattern::Echo) return;
+        compactPending();
+        mPending.append(data.begin(), data.end());
+    }
+
+private:
+
+    static constexpr uint64_t SCHEDULE_SEED = 0x9E3779B97F4A7C15;
+
+    static constexpr std::array<const char*, 4> sPatternNames = {"lines", "binary", "telemetry", "echo"};
+
+    SimulatorConfig mConfig;
+    std::mt19937_64 mContentRng;
+    std::mt19937_64 mScheduleRng;   // separate, so the content never shifts the disconnect times
+    uint32_t mBaudrate = 115200;
+
+    std::string mPending;
+    size_t mPendingPos = 0;
+    double mCredit = 0;
+    uint64_t mSequence = 0;
+    std::chrono::steady_clock::time_point mLastRead;
+    std::chrono::steady_clock::time_point mNextRecord;
+    std::chrono::steady_clock::time_point mAbsentUntil;
+    std::optional<std::chrono::steady_clock::time_point> mNextDisconnect;
+
+    double byteRate() const { return (mConfig.byteRate > 0) ? mConfig.byteRate : mBaudrate / 10.0; }
+
+    void scheduleDisconnect(const std::chrono::steady_clock::time_point now) {
+        if (mConfig.meanTimeToDisconnect.count() == 0) return;
+        std::exponential_distribution<double> uptime(1.0 / mConfig.meanTimeToDisconnect.count());
+        mNextDisconnect = now + std::chrono::milliseconds(static_cast<int64_t>(uptime(mScheduleRng)) + 1);
+    }
+
+    void compactPending() {
+        mPending.erase(0, mPendingPos);
+        mPendingPos = 0;
+    }
+
+    // Appends the next unit of output, returns false when there is nothing to send yet.
+    bool generate(const std::chrono::steady_clock::time_point now) {
+
+        compactPending();
+
+        switch (mConfig.pattern) {
+
+            case SimPattern::Lines: {
+                static constexpr std::string_view alphabet = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789 ";
+                std::format_to(std::back_inserter(mPending), "line {} ", mSequence++);
+                const size_t length = 20 + mContentRng() % 80;
+                for (size_t i = 0; i < length; i++) { mPending += alphabet[mContentRng() % alphabet.size()]; }
+                mPending += "\r\n";
+                return true;
+            }
+
+            case SimPattern::Binary: {
+                // a burst, then silence for as long as the burst takes on the line
+                if (now < mNextRecord) return false;
+                const size_t length = 64 + mContentRng() % 448;
+                for (size_t i = 0; i < length; i++) { mPending += static_cast<char>(mContentRng() & 0xFF); }
+                mNextRecord = now + std::chrono::microseconds(static_cast<int64_t>(2 * length * 1e6 / byteRate()));
+                return true;
+            }
+
+            case SimPattern::Telemetry: {
+                if (now < mNextRecord) return false;
+                std::normal_distribution<double> noise(0.0, 1.0);
+                const double t = mSequence * mConfig.telemetryPeriod.count() / 1000.0;
+                std::format_to(std::back_inserter(mPending), "seq={},temp={:.2f},hum={:.1f},vbat={:.3f}\r\n",
+                    mSequence, 21.0 + 2.0 * std::sin(t / 10.0) + 0.1 * noise(mContentRng), 45.0 + 0.5 * noise(mContentRng), 3.7 - 0.0001 * mSequence);
+                mSequence++;
+                mNextRecord = std::max(mNextRecord + mConfig.telemetryPeriod, now - mConfig.telemetryPeriod);
+                return true;
+            }
+
+            case SimPattern::Echo:
+                return false;
+        }
+
+        return false;
+    }
+
+};
+
+#endif // SIMULATED_DEVICE_H
@@ -0,0 +1,235 @@
+#ifndef SOCKET_BRIDGE_H
+#define SOCKET_BRIDGE_H
+
+#include "serial_windows.hpp"
+#include <winsock2.h>
+#include <ws2tcpip.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <format>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// Shares the open port with other tools over a local TCP socket. Every received chunk
+// is wrapped once in a reference counted buffer and queued to all clients, the bridge
+// thread writes them out with non-blocking sockets. Bytes sent by a client are passed
+// to Serial::send. A client whose backlog exceeds the limit is dropped, it can never
+// hold up the reader or the other clients.
+class SocketBridge {
+public:
+
+    static constexpr size_t DEFAULT_BACKLOG_LIMIT = 4 * 1024 * 1024;
+
+    SocketBridge(Serial& serial) : mSerial(serial) { }
+
+    ~SocketBridge() { stop(); }
+
+    bool start(const uint16_t port, const size_t backlogLimit = DEFAULT_BACKLOG_LIMIT) {
+
+        if (mRunning) return false;
+
+        WSADATA wsaData;
+        if (WSAStartup(MAKEWORD(2, 2), &wsaData) != 0) { setStatus("BRIDGE WSAStartup failed"); return false; }
+
+        mListener = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+        if (mListener == INVALID_SOCKET) { setStatus("BRIDGE socket failed"); WSACleanup(); return false; }
+
+        // only local tools, the bridge has no authentication
+        sockaddr_in address = {};
+        address.sin_family = AF_INET;
+        address.sin_port = htons(port);
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+        u_long nonBlocking = 1;
+        if (bind(mListener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == SOCKET_ERROR ||
+            listen(mListener, SOMAXCONN) == SOCKET_ERROR ||
+            ioctlsocket(mListener, FIONBIO, &nonBlocking) == SOCKET_ERROR) {
+            setStatus(std::format("BRIDGE cannot listen on {}", port));
+            closesocket(mListener);
+            mListener = INVALID_SOCKET;
+            WSACleanup();
+            return false;
+        }
+
+        mPort = port;
+        mBacklogLimit = backlogLimit;
+        mRunning = true;
+        mWorker = std::thread([this]() { run(); });
+        return true;
+    }
+
+    void stop() {
+        if (!mRunning) return;
+        mRunning = false;
+        mWorker.join();
+
+        std::scoped_lock<std::mutex> lock(mMutex);
+        for (auto& client : mClients) { closesocket(client.socket); }
+        mClients.clear();
+        closesocket(mListener);
+        mListener = INVALID_SOCKET;
+        WSACleanup();
+    }
+
+    bool running() const { return mRunning; }
+
+    // Runs on the reader thread, one allocation per chunk however many clients there are.
+    void onReceive(std::span<const uint8_t> data, const std::chrono::steady_clock::time_point) {
+
+        std::scoped_lock<std::mutex> lock(mMutex);
+        if (mClients.empty()) return;
+
+        const auto chunk = std::make_shared<const std::vector<uint8_t>>(data.begin(), data.end());
+        for (auto& client : mClients) {
+            if (client.dropped) continue;
+            client.backlog.push_back(chunk);
+            client.backlogBytes += chunk->size();
+            if (client.backlogBytes > mBacklogLimit) { client.dropped = true; }
+        }
+    }
+
+    // What clients sent to the port since the last call, for the transmit rows of the view.
+    bool takeTransmitted(std::string& out) {
+        std::scoped_lock<std::mutex> lock(mMutex);
+        out.clear();
+        std::swap(out, mTransmitted);
+        return !out.empty();
+    }
+
+    std::string getStatus() const {
+        std::scoped_lock<std::mutex> lock(mMutex);
+        if (!mRunning) return mStatus;
+        return std::format("BRIDGE :{} {} client{}{}", mPort, mClients.size(), (mClients.size() == 1) ? "" : "s",
+            (mSlowClientsDropped > 0) ? std::format(" ({} dropped)", mSlowClientsDropped) : "");
+    }
+
+private:
+
+    using Chunk = std::shared_ptr<const std::vector<uint8_t>>;
+
+    struct Client {
+        SOCKET socket = INVALID_SOCKET;
+        std::deque<Chunk> backlog;
+        size_t backlogBytes = 0;
+        size_t offset = 0;              // bytes of the front chunk already written
+        bool dropped = false;
+    };
+
+    static constexpr timeval SELECT_TIMEOUT = { 0, 5000 };
+    static constexpr size_t MAX_TRANSMITTED = 64 * 1024;
+
+    Serial& mSerial;
+    std::thread mWorker;
+    std::atomic<bool> mRunning = false;
+    mutable std::mutex mMutex;
+
+    SOCKET mListener = INVALID_SOCKET;
+    uint16_t mPort = 0;
+    size_t mBacklogLimit = DEFAULT_BACKLOG_LIMIT;
+    std::vector<Client> mClients;
+    uint32_t mSlowClientsDropped = 0;
+    std::string mTransmitted;
+    std::string mStatus;
+
+    void setStatus(std::string status) {
+        std::scoped_lock<std::mutex> lock(mMutex);
+        mStatus = std::move(status);
+    }
+
+    void run() {
+
+        std::array<char, 4096> receiveBuffer;
+        std::string toSend;
+
+        while (mRunning) {
+
+            fd_set readable;
+            fd_set writable;
+            FD_ZERO(&readable);
+            FD_ZERO(&writable);
+            FD_SET(mListener, &readable);
+            {
+                std::scoped_lock<std::mutex> lock(mMutex);
+                for (const auto& client : mClients) {
+                    FD_SET(client.socket, &readable);
+                    if (!client.backlog.empty()) { FD_SET(client.socket, &writable); }
+                }
+            }
+
+            // a short timeout, chunks queued by the reader are picked up on the next round
+            timeval timeout = SELECT_TIMEOUT;
+            if (select(0, &readable, &writable, nullptr, &timeout) == SOCKET_ERROR) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(5));
+                continue;
+            }
+
+            std::unique_lock<std::mutex> lock(mMutex);
+
+            if (FD_ISSET(mListener, &readable) && mClients.size() < FD_SETSIZE - 1) {
+                if (const SOCKET socket = accept(mListener, nullptr, nullptr); socket != INVALID_SOCKET) {
+                    u_long nonBlocking = 1;
+                    ioctlsocket(socket, FIONBIO, &nonBlocking);
+                    mClients.push_back(Client{ .socket = socket });
+                }
+            }
+
+            for (auto& client : mClients) {
+
+                if (client.dropped) continue;
+
+                if (FD_ISSET(client.socket, &readable)) {
+                    const int n = recv(client.socket, receiveBuffer.data(), static_cast<int>(receiveBuffer.size()), 0);
+                    if (n > 0) {
+                        toSend.append(receiveBuffer.data(), n);
+                    } else if (n == 0 || WSAGetLastError() != WSAEWOULDBLOCK) {
+                        client.dropped = true;
+                        continue;
+                    }
+                }
+
+                while (!client.backlog.empty()) {
+                    const auto& chunk = *client.backlog.front();
+                    const int n = send(client.socket, reinterpret_cast<const char*>(chunk.data() + client.offset), static_cast<int>(chunk.size() - client.offset), 0);
+                    if (n == SOCKET_ERROR) {
+                        if (WSAGetLastError() != WSAEWOULDBLOCK) { client.dropped = true; }
+                        break;
+                    }
+                    client.offset += n;
+                    if (client.offset < chunk.size()) break;
+                    client.backlogBytes -= chunk.size();
+                    client.backlog.pop_front();
+                    client.offset = 0;
+                }
+            }
+
+            std::erase_if(mClients, [this](const Client& client) {
+                if (!client.dropped) return false;
+                if (client.backlogBytes > mBacklogLimit) { mSlowClientsDropped++; }
+                closesocket(client.socket);
+                return true;
+            });
+
+            if (toSend.empty()) continue;
+            if (mTransmitted.size() < MAX_TRANSMITTED) { mTransmitted += toSend; }
+
+            // the reader holds the serial mutex while it calls onReceive, never send with ours held
+            lock.unlock();
+            mSerial.send(toSend.data(), toSend.size());
+            toSend.clear();
+        }
+
+    }
+
+};
+
+#endif // SOCKET_BRIDGE_H
@@ -0,0 +1,271 @@
+#ifndef TRIGGER_CAPTURE_H
+#define TRIGGER_CAPTURE_H
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <charconv>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <filesystem>
+#include <format>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "AhoCorasick.hpp"
+
+struct TriggerConfig {
+    std::vector<std::string> patterns;          // raw byte sequences, text or decoded hex
+    size_t preBytes  = 64 * 1024;
+    size_t postBytes = 64 * 1024;
+    std::chrono::milliseconds preTime{0};       // 0 bounds the window by bytes only
+    std::chrono::milliseconds postTime{0};
+    std::filesystem::path directory = ".";
+};
+
+// Logic analyzer style capture. The reader thread feeds every received chunk through
+// onReceive(), which keeps a bounded pre-trigger ring and runs the patterns through an
+// Aho-Corasick automaton. When a pattern matches, the ring and the following post-trigger
+// bytes form a window that a writer thread saves to its own file.
+class TriggerCapture {
+public:
+
+    static constexpr size_t MAX_WINDOW_BYTES = 16 * 1024 * 1024;
+
+    TriggerCapture() { mWriter = std::thread([this]() { writeLoop(); }); }
+
+    ~TriggerCapture() {
+        {
+            std::scoped_lock<std::mutex> lock(mMutex);
+            mRunning = false;
+        }
+        mCondition.notify_one();
+        mWriter.join();
+    }
+
+    void configure(TriggerConfig config) {
+        std::scoped_lock<std::mutex> lock(mMutex);
+        mConfig = std::move(config);
+        mConfig.preBytes = std::min(mConfig.preBytes, MAX_WINDOW_BYTES);
+        mConfig.postBytes = std::min(mConfig.postBytes, MAX_WINDOW_BYTES);
+        mMatcher.build(mConfig.patterns);
+        mRing.clear();
+        mRingBytes = 0;
+        mWindow.reset();
+        mArmed = !mMatcher.empty();
+    }
+
+    bool configured() const { return !mConfig.patterns.empty(); }
+
+    void toggleArmed() {
+        std::scoped_lock<std::mutex> lock(mMutex);
+        if (mMatcher.empty()) return;
+        mArmed = !mArmed;
+        mMatcher.reset();
+        if (!mArmed) { closeWindow(); }
+    }
+
+    bool armed() const { return mArmed; }
+
+    uint32_t getTriggerCount() const { return mTriggers; }
+
+    std::string getStatus() const {
+        if (!configured()) return "";
+        std::scoped_lock<std::mutex> lock(mMutex);
+        if (!mError.empty()) return mError;
+        return std::format("TRIG{} {}{}", mArmed ? "" : " OFF", mTriggers.load(), mWindow ? " *" : "");
+    }
+
+    // Runs on the reader thread, costs one table lookup per byte while armed.
+    void onReceive(std::span<const uint8_t> data, const std::chrono::steady_clock::time_point time) {
+
+        std::scoped_lock<std::mutex> lock(mMutex);
+        if (!mArmed || data.empty()) return;
+
+        if (mWindow && postTimeElapsed(time)) { closeWindow(); }
+
+        for (size_t i = 0; i < data.size(); i++) {
+
+            const int pattern = mMatcher.feed(data[i]);
+
+            if (mWindow) {
+                mWindow->bytes.push_back(data[i]);
+                if (++mWindow->postBytes >= mConfig.postBytes) { closeWindow(); }
+            } else if (pattern != AhoCorasick::NO_MATCH) {
+                openWindow(data.first(i + 1), pattern, time);
+            }
+        }
+
+        pushRing(data, time);
+    }
+
+    // Accepts "DE AD BE EF", "deadbeef" or "0xDE,0xAD".
+    static std::optional<std::string> parseHex(std::string_view hex) {
+        std::string bytes;
+        std::string digits;
+        for (size_t i = 0; i < hex.size(); i++) {
+            if (hex[i] == '0' && i + 1 < hex.size() && (hex[i + 1] == 'x' || hex[i + 1] == 'X')) { i++; continue; }
+            if (std::isxdigit(static_cast<unsigned char>(hex[i]))) {
+                digits += hex[i];
+            } else if (hex[i] != ' ' && hex[i] != ',' && hex[i] != ':') {
+                return std::nullopt;
+            }
+        }
+        if (digits.empty() || digits.size() % 2 != 0) return std::nullopt;
+        for (size_t i = 0; i < digits.size(); i += 2) {
+            uint8_t value = 0;
+            std::from_chars(digits.data() + i, digits.data() + i + 2, value, 16);
+            bytes += static_cast<char>(value);
+        }
+        return bytes;
+    }
+
+    // "4096" is a byte count, "2s" or "500ms" a duration.
+    static bool parseExtent(std::string_view arg, size_t& bytes, std::chrono::milliseconds& time) {
+        uint64_t value = 0;
+        const auto [ptr, ec] = std::from_chars(arg.data(), arg.data() + arg.size(), value);
+        if (ec != std::errc() || ptr == arg.data()) return false;
+        const std::string_view unit(ptr, arg.data() + arg.size());
+        if (unit.empty()) {
+            bytes = value;
+            time = std::chrono::milliseconds(0);
+        } else if (unit == "s" || unit == "ms") {
+            bytes = MAX_WINDOW_BYTES;
+            time = std::chrono::milliseconds((unit == "s") ? value * 1000 : value);
+        } else {
+            return false;
+        }
+        return true;
+    }
+
+private:
+
+    struct Chunk {
+        std::chrono::steady_clock::time_point time;
+        std::vector<uint8_t> bytes;
+    };
+
+    struct Window {
+        uint32_t index = 0;
+        int pattern = 0;
+        std::chrono::steady_clock::time_point time;
+        std::chrono::system_clock::time_point wallTime;
+        std::vector<uint8_t> bytes;
+        size_t postBytes = 0;
+    };
+
+    mutable std::mutex mMutex;
+    std::condition_variable mCondition;
+    std::thread mWriter;
+    bool mRunning = true;
+
+    TriggerConfig mConfig;
+    AhoCorasick mMatcher;
+    std::atomic<bool> mArmed = false;
+    std::atomic<uint32_t> mTriggers = 0;
+    std::string mError;
+
+    std::deque<Chunk> mRing;
+    size_t mRingBytes = 0;
+    std::optional<Window> mWindow;
+    std::deque<Window> mPending;
+
+    void pushRing(std::span<const uint8_t> data, const std::chrono::steady_clock::time_point time) {
+
+        mRing.push_back(Chunk{ time, std::vector<uint8_t>(data.begin(), data.end()) });
+        mRingBytes += data.size();
+
+        // whole chunks are dropped, the window start is trimmed exactly when it opens
+        while (mRing.size() > 1 && mRingBytes - mRing.front().bytes.size() >= mConfig.preBytes) {
+            mRingBytes -= mRing.front().bytes.size();
+            mRing.pop_front();
+        }
+        trimRing(time);
+    }
+
+    void trimRing(const std::chrono::steady_clock::time_point now) {
+        if (mConfig.preTime.count() == 0) return;
+        while (!mRing.empty() && now - mRing.front().time > mConfig.preTime) {
+            mRingBytes -= mRing.front().bytes.size();
+            mRing.pop_front();
+        }
+    }
+
+    void openWindow(std::span<const uint8_t> head, const int pattern, const std::chrono::steady_clock::time_point time) {
+
+        trimRing(time);
+
+        Window window{ .index = ++mTriggers, .pattern = pattern, .time = time, .wallTime = std::chrono::system_clock::now() };
+
+        const size_t preBytes = std::min(mConfig.preBytes, mRingBytes + head.size());
+        window.bytes.reserve(preBytes + std::min(mConfig.postBytes, MAX_WINDOW_BYTES / 4));
+
+        size_t skip = mRingBytes + head.size() - preBytes;
+        for (const auto& chunk : mRing) {
+            const size_t from = std::min(skip, chunk.bytes.size());
+            skip -= from;
+            window.bytes.insert(window.bytes.end(), chunk.bytes.begin() + from, chunk.bytes.end());
+        }
+        const size_t from = std::min(skip, head.size());
+        window.bytes.insert(window.bytes.end(), head.begin() + from, head.end());
+
+        mWindow = std::move(window);
+        if (mConfig.postBytes == 0) { closeWindow(); }
+    }
+
+    bool postTimeElapsed(const std::chrono::steady_clock::time_point now) const {
+        return mConfig.postTime.count() > 0 && now - mWindow->time >= mConfig.postTime;
+    }
+
+    void closeWindow() {
+        if (!mWindow) return;
+        mPending.push_back(std::move(*mWindow));
+        mWindow.reset();
+        mCondition.notify_one();
+    }
+
+    void writeLoop() {
+
+        using namespace std::chrono;
+
+        std::unique_lock<std::mutex> lock(mMutex);
+        while (mRunning || !mPending.empty()) {
+
+            // wakes up regularly to close time bounded windows on a quiet line
+            mCondition.wait_for(lock, milliseconds(50), [this]() { return !mRunning || !mPending.empty(); });
+
+            if (mWindow && (!mRunning || postTimeElapsed(steady_clock::now()))) { closeWindow(); }
+            if (mPending.empty()) continue;
+
+            Window window = std::move(mPending.front());
+            mPending.pop_front();
+            const auto directory = mConfig.directory;
+            lock.unlock();
+
+            const auto file = directory / std::format("trigger-{:%Y%m%d-%H%M%S}-{}.bin", floor<seconds>(window.wallTime), window.index);
+            std::string error;
+            if (std::FILE* out = std::fopen(file.string().c_str(), "wb"); out != nullptr) {
+                if (std::fwrite(window.bytes.data(), 1, window.bytes.size(), out) != window.bytes.size()) { error = std::format("TRIG WRITE FAILED {}", file.string()); }
+                std::fclose(out);
+            } else {
+                error = std::format("TRIG WRITE FAILED {}", file.string());
+            }
+
+            lock.lock();
+            if (!error.empty()) { mError = std::move(error); }
+        }
+
+    }
+
+};
+
+#endif // TRIGGER_CAPTURE_H
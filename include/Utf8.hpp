@@ -0,0 +1,124 @@
+#ifndef UTF8_H
+#define UTF8_H
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <span>
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#define UTF8_USE_SSE2 1
+#include <emmintrin.h>
+#endif
+
+namespace utf8 {
+
+    enum class Status {
+        Valid,
+        Invalid,
+        Incomplete,
+    };
+
+    struct Codepoint {
+        char32_t value = 0;
+        uint8_t length = 1;
+        Status status = Status::Invalid;
+    };
+
+    // Number of leading bytes below 0x80. Checks 16 bytes per step where SSE2 is
+    // available, which is the common case for serial logs.
+    inline size_t asciiPrefix(std::span<const uint8_t> bytes) {
+
+        size_t i = 0;
+
+#ifdef UTF8_USE_SSE2
+        for (; i + 16 <= bytes.size(); i += 16) {
+            const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(bytes.data() + i));
+            const int mask = _mm_movemask_epi8(chunk);
+            if (mask != 0) { return i + std::countr_zero(static_cast<uint32_t>(mask)); }
+        }
+#else
+        for (; i + 8 <= bytes.size(); i += 8) {
+            uint64_t chunk;
+            std::memcpy(&chunk, bytes.data() + i, sizeof(chunk));
+            if (chunk & 0x8080808080808080ull) break;
+        }
+#endif
+
+        for (; i < bytes.size(); i++) {
+            if (bytes[i] & 0x80) return i;
+        }
+        return i;
+    }
+
+    inline Codepoint decode(std::span<const uint8_t> bytes) {
+
+        if (bytes.empty()) return Codepoint{ .status = Status::Incomplete };
+
+        const uint8_t lead = bytes[0];
+        if (lead < 0x80) return Codepoint{ .value = lead, .length = 1, .status = Status::Valid };
+
+        uint8_t length = 0;
+        char32_t value = 0;
+        char32_t minimum = 0;
+
+        if ((lead & 0xE0) == 0xC0) { length = 2; value = lead & 0x1F; minimum = 0x80; }
+        else if ((lead & 0xF0) == 0xE0) { length = 3; value = lead & 0x0F; minimum = 0x800; }
+        else if ((lead & 0xF8) == 0xF0) { length = 4; value = lead & 0x07; minimum = 0x10000; }
+        else { return Codepoint{}; }
+
+        for (uint8_t i = 1; i < length; i++) {
+            if (i >= bytes.size()) return Codepoint{ .length = length, .status = Status::Incomplete };
+            if ((bytes[i] & 0xC0) != 0x80) return Codepoint{};
+            value = (value << 6) | (bytes[i] & 0x3F);
+        }
+
+        if (value < minimum || value > 0x10FFFF || (value >= 0xD800 && value <= 0xDFFF)) return Codepoint{};
+
+        return Codepoint{ .value = value, .length = length, .status = Status::Valid };
+    }
+
+    struct Range {
+        char32_t first;
+        char32_t last;
+    };
+
+    inline constexpr std::array<Range, 23> sZeroWidth = {{
+        {0x0300, 0x036F}, {0x0483, 0x0489}, {0x0591, 0x05BD}, {0x0610, 0x061A},
+        {0x064B, 0x065F}, {0x0E31, 0x0E31}, {0x0E34, 0x0E3A}, {0x0E47, 0x0E4E},
+        {0x1AB0, 0x1AFF}, {0x1DC0, 0x1DFF}, {0x200B, 0x200F}, {0x202A, 0x202E},
+        {0x2060, 0x2064}, {0x20D0, 0x20FF}, {0x302A, 0x302D}, {0x3099, 0x309A},
+        {0xFE00, 0xFE0F}, {0xFE20, 0xFE2F}, {0xFEFF, 0xFEFF}, {0x1F3FB, 0x1F3FF},
+        {0xE0001, 0xE0001}, {0xE0020, 0xE007F}, {0xE0100, 0xE01EF},
+    }};
+
+    inline constexpr std::array<Range, 19> sWide = {{
+        {0x1100, 0x115F}, {0x231A, 0x231B}, {0x2329, 0x232A}, {0x23E9, 0x23EC},
+        {0x2E80, 0x303E}, {0x3041, 0x33FF}, {0x3400, 0x4DBF}, {0x4E00, 0x9FFF},
+        {0xA000, 0xA4CF}, {0xAC00, 0xD7A3}, {0xF900, 0xFAFF}, {0xFE30, 0xFE4F},
+        {0xFF00, 0xFF60}, {0xFFE0, 0xFFE6}, {0x1F300, 0x1F64F}, {0x1F900, 0x1F9FF},
+        {0x1FA70, 0x1FAFF}, {0x20000, 0x2FFFD}, {0x30000, 0x3FFFD},
+    }};
+
+    template<size_t N>
+    bool inRanges(const std::array<Range, N>& ranges, const char32_t cp) {
+        const auto it = std::upper_bound(ranges.begin(), ranges.end(), cp, [](const char32_t v, const Range& r) { return v < r.first; });
+        return it != ranges.begin() && cp <= std::prev(it)->last;
+    }
+
+    // Terminal columns taken by a codepoint: 0 for combining marks, 2 for east asian
+    // wide and emoji, 1 otherwise.
+    inline uint8_t width(const char32_t cp) {
+        if (cp < 0x300) return 1;
+        if (inRanges(sZeroWidth, cp)) return 0;
+        if (inRanges(sWide, cp)) return 2;
+        return 1;
+    }
+
+} // namespace utf8
+
+#endif // UTF8_H
@@ -1,3 +1,4 @@
+#include <array>
 #include <cstddef>
 #include <string>
 
@@ -13,9 +14,25 @@ public:
     void push_back(const T& item) {
         mBuffer[mTail] = item;
         mTail = (mTail + 1) % N;
+        if (mSize == N) {
+            mHead = mTail;
+        } else {
+            mSize++;
+        }
     }
-    
-    
+
+    // index 0 is the oldest item
+    const T& operator[](const size_t index) const { return mBuffer[(mHead + index) % N]; }
+
+    const T& back() const { return mBuffer[(mTail + N - 1) % N]; }
+
+    size_t size() const { return mSize; }
+
+    bool empty() const { return mSize == 0; }
+
+    static constexpr size_t capacity() { return N; }
+
+    void clear() { mHead = 0; mTail = 0; mSize = 0; }
 
 private:
 
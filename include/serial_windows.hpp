@@ -4,6 +4,7 @@
 #define NOMINMAX 1
 #define WIN32_LEAN_AND_MEAN
 #include "Windows.h"
+#include <atomic>
 #include <chrono>
 #include <cstdint>
 #include <thread>
@@ -11,8 +12,15 @@
 #include <array>
 #include <mutex>
 #include <algorithm>
+#include <format>
+#include <functional>
+#include <memory>
+#include <span>
+#include <utility>
 #include <vector>
 
+#include "SimulatedDevice.hpp"
+
 class Serial {
 
 public:
@@ -28,6 +36,7 @@ public:
         CannotSetCommState,
         CannotSetCommTimeout,
         CannotGetCommTimeout,
+        DeviceDisconnected,
         
     };
 
@@ -52,38 +61,103 @@ public:
         SPACE = SPACEPARITY,
     };
 
+    enum class FlowControl {
+        None,
+        RtsCts,
+        XonXoff,
+    };
+
+    struct LineErrors {
+        uint32_t framing = 0;
+        uint32_t parity  = 0;
+        uint32_t breaks  = 0;
+        uint32_t overrun = 0;   // the uart lost bytes before the driver could fetch them
+        uint32_t rxOver  = 0;   // the driver input queue was full
+    };
+
+    // Called on the reader thread for every chunk read from the port, before the ui sees it.
+    using ReceiveListener = std::function<void(std::span<const uint8_t>, std::chrono::steady_clock::time_point)>;
+
     Error open(const std::string& port, const uint32_t baudrate = 115200) {
 
         std::scoped_lock<std::mutex> lock(mMutex);
 
-        if (mIsOpen) { CloseHandle(mSerialHandle); mIsOpen = false; }
+        closeHandle();
                 
         mPort = port;
         mBaudrate = baudrate;
-        
-        mSerialHandle = CreateFile(
-            ("\\\\.\\" + mPort).c_str(),
-            GENERIC_READ | GENERIC_WRITE,
-            0,
-            nullptr,
-            OPEN_EXISTING,
-            FILE_ATTRIBUTE_NORMAL,
-            nullptr
-        );
+        mReconnecting = false;
+        mSimulator.reset();
+        mLineErrors = LineErrors{};
 
-        if (mSerialHandle == INVALID_HANDLE_VALUE) {
-            mError = Error::UnableToOpenPort;
-            return mError;
-        } else {
-            mIsOpen = true;
-        }
+        mError = openHandle(true);
+        return mError;
 
-        mError = configurePort();
+    }
+
+    // Opens an in-process simulated device instead of a port. Everything downstream of
+    // read() and send() behaves as with real hardware, including disconnects.
+    Error openSimulated(const SimulatorConfig& config, const uint32_t baudrate = 115200) {
+
+        std::scoped_lock<std::mutex> lock(mMutex);
+
+        closeHandle();
+
+        mPort = std::format("SIM:{}", SimulatedDevice::name(config.pattern));
+        mBaudrate = baudrate;
+        mReconnecting = false;
+        mSimulator = std::make_unique<SimulatedDevice>(config);
+
+        mError = openHandle(true);
         return mError;
 
     }
 
-    Error configurePort() {
+    // Called periodically by the reader thread. After a disconnect the port is reopened
+    // with the same settings, backing off exponentially while the device is absent.
+    void maintainConnection() {
+
+        std::scoped_lock<std::mutex> lock(mMutex);
+
+        if (!mReconnecting) return;
+
+        const auto now = std::chrono::steady_clock::now();
+        if (now < mNextReconnect) return;
+
+        // the driver queue of a fresh device already holds its first bytes, keep them
+        if (openHandle(false) == Error::None) {
+            mReconnecting = false;
+            mReconnectAttempts = 0;
+            mError = Error::None;
+            return;
+        }
+
+        closeHandle();
+        mError = Error::DeviceDisconnected;
+        mReconnectAttempts++;
+        const auto backoff = std::min(RECONNECT_MIN_BACKOFF * (1 << std::min<uint32_t>(mReconnectAttempts, 10)), RECONNECT_MAX_BACKOFF);
+        mNextReconnect = now + backoff;
+
+    }
+
+    // Skips the remaining backoff, e.g. when the port list changed.
+    void reconnectNow() {
+        std::scoped_lock<std::mutex> lock(mMutex);
+        mNextReconnect = std::chrono::steady_clock::now();
+    }
+
+    bool isReconnecting() const { return mReconnecting; }
+
+    uint32_t getReconnectAttempts() const { return mReconnectAttempts; }
+
+    Error configurePort(const bool purge = true) {
+
+        if (mSimulator) { mSimulator->setBaudrate(mBaudrate); return Error::None; }
+
+        // only a request, the driver may round or ignore the sizes
+        if (mRxQueueSize > 0 || mTxQueueSize > 0) {
+            SetupComm(mSerialHandle, mRxQueueSize > 0 ? mRxQueueSize : DEFAULT_QUEUE_SIZE, mTxQueueSize > 0 ? mTxQueueSize : DEFAULT_QUEUE_SIZE);
+        }
 
         DCB serialConfig = {0};
 
@@ -93,13 +167,21 @@ public:
         serialConfig.ByteSize    = mDataBits;
         serialConfig.StopBits    = mStopBits;
         serialConfig.Parity      = mParity;
-        serialConfig.fOutxCtsFlow = false;
-        serialConfig.fRtsControl = RTS_CONTROL_DISABLE;
-        serialConfig.fOutX = false;
-        serialConfig.fInX = false;
-
+        serialConfig.fOutxCtsFlow = (mFlowControl == FlowControl::RtsCts);
+        serialConfig.fRtsControl = (mFlowControl == FlowControl::RtsCts) ? RTS_CONTROL_HANDSHAKE : RTS_CONTROL_DISABLE;
+        serialConfig.fOutX = (mFlowControl == FlowControl::XonXoff);
+        serialConfig.fInX = (mFlowControl == FlowControl::XonXoff);
+
+        if (mFlowControl == FlowControl::XonXoff) {
+            // XOFF once the input queue is three quarters full, XON again below a quarter
+            const uint32_t queue = mRxQueueSize > 0 ? mRxQueueSize : DEFAULT_QUEUE_SIZE;
+            serialConfig.XonChar  = XON;
+            serialConfig.XoffChar = XOFF;
+            serialConfig.XonLim   = static_cast<WORD>(std::min<uint32_t>(queue / 4, 0xFFFF));
+            serialConfig.XoffLim  = static_cast<WORD>(std::min<uint32_t>(queue / 4, 0xFFFF));
+        }
         
-        if (!SetCommState(mSerialHandle, &serialConfig)) return Error::CannotGetCommState;
+        if (!SetCommState(mSerialHandle, &serialConfig)) return Error::CannotSetCommState;
 
         COMMTIMEOUTS serialTimeouts = {0};
         if (!GetCommTimeouts(mSerialHandle, &serialTimeouts)) return Error::CannotGetCommTimeout;
@@ -108,22 +190,22 @@ public:
 
         if (!SetCommTimeouts(mSerialHandle, &serialTimeouts)) return Error::CannotSetCommTimeout;
         
-        PurgeComm(mSerialHandle, PURGE_RXCLEAR | PURGE_TXCLEAR);
+        if (purge) { PurgeComm(mSerialHandle, PURGE_RXCLEAR | PURGE_TXCLEAR); }
         return Error::None;
     }
 
 
-    size_t copyBytes(uint8_t* dest) {
+    // Hands over everything read since the last call, dest is swapped with the internal
+    // buffer so both keep their capacity.
+    size_t copyBytes(std::vector<uint8_t>& dest) {
 
         std::scoped_lock<std::mutex> lock(mMutex);
 
-        if (!mIsOpen || mNumBytesInBuffer == 0) return 0;
+        dest.clear();
+        if (!mIsOpen || mBuffer.empty()) return 0;
 
-        std::copy(mBuffer.begin(), mBuffer.begin()+mNumBytesInBuffer, dest);
-        
-        const auto bytesCopied = mNumBytesInBuffer;
-        mNumBytesInBuffer = 0;
-        return bytesCopied;
+        std::swap(dest, mBuffer);
+        return dest.size();
 
     }
             
@@ -132,17 +214,32 @@ public:
         std::scoped_lock<std::mutex> lock(mMutex);
 
         if (!mIsOpen) { return 0; }
+
+        if (mSimulator) { return readSimulated(); }
         
         DWORD err;
         COMSTAT stat;
     
-        ClearCommError(mSerialHandle, &err, &stat);
+        // a removed usb adapter invalidates the handle, every call on it fails from then on
+        if (!ClearCommError(mSerialHandle, &err, &stat)) { handleDisconnect(); return 0; }
+        countLineErrors(err);
         DWORD bytesRead;
 
         if (stat.cbInQue == 0) { return 0; }
 
-        ReadFile(mSerialHandle, &mBuffer[mNumBytesInBuffer], stat.cbInQue, &bytesRead, nullptr);
-        mNumBytesInBuffer += bytesRead;
+        // the buffer grows while the ui is slow instead of leaving bytes in the driver queue
+        const DWORD bytesToRead = std::min<DWORD>(stat.cbInQue, static_cast<DWORD>(MAX_BUFFERED_BYTES - mBuffer.size()));
+        if (bytesToRead == 0) { return 0; }
+
+        const size_t offset = mBuffer.size();
+        mBuffer.resize(offset + bytesToRead);
+        if (!ReadFile(mSerialHandle, &mBuffer[offset], bytesToRead, &bytesRead, nullptr)) { mBuffer.resize(offset); handleDisconnect(); return 0; }
+        mBuffer.resize(offset + bytesRead);
+
+        if (bytesRead > 0 && !mReceiveListeners.empty()) {
+            const auto now = std::chrono::steady_clock::now();
+            for (const auto& listener : mReceiveListeners) { listener(std::span<const uint8_t>(&mBuffer[offset], bytesRead), now); }
+        }
 
         return bytesRead;
 
@@ -154,6 +251,11 @@ public:
 
         if (!mIsOpen) { return 0; }
 
+        if (mSimulator) {
+            mSimulator->write(std::span<const uint8_t>(reinterpret_cast<const uint8_t*>(buffer), length));
+            return true;
+        }
+
         DWORD bytesWritten = 0;
         
         if (!WriteFile(mSerialHandle, buffer, length, &bytesWritten, nullptr)) { return false; }
@@ -167,6 +269,7 @@ public:
 
     void sendBreakState() {
         std::scoped_lock<std::mutex> lock(mMutex);
+        if (mSimulator || !mIsOpen) return;
         SetCommBreak(mSerialHandle);
         std::this_thread::sleep_for(std::chrono::milliseconds(5));
         ClearCommBreak(mSerialHandle);
@@ -174,7 +277,11 @@ public:
 
     bool isConnected() { return mIsOpen; }
 
-    void close() { CloseHandle(mSerialHandle); mIsOpen = false; }
+    void close() {
+        std::scoped_lock<std::mutex> lock(mMutex);
+        closeHandle();
+        mReconnecting = false;
+    }
 
     const std::string getPortName() const { return mPort; }
 
@@ -188,6 +295,17 @@ public:
 
     void setParity(const Parity parity) { mParity = parity; }
 
+    void setFlowControl(const FlowControl flowControl) { mFlowControl = flowControl; }
+
+    // Driver queue sizes in bytes, 0 keeps the driver default. Applied on the next open.
+    void setQueueSizes(const uint32_t rxQueueSize, const uint32_t txQueueSize) { mRxQueueSize = rxQueueSize; mTxQueueSize = txQueueSize; }
+
+    FlowControl getFlowControl() const { return mFlowControl; }
+
+    uint32_t getRxQueueSize() const { return mRxQueueSize; }
+
+    uint32_t getTxQueueSize() const { return mTxQueueSize; }
+
     const std::string getLastError() const {
         switch(mError) {
             case Error::None: return "";
@@ -196,29 +314,121 @@ public:
             case Error::CannotSetCommState: return "CannotSetCommState";
             case Error::CannotSetCommTimeout: return "CannotSetCommTimeout";
             case Error::CannotGetCommTimeout: return "CannotGetCommTimeout";
+            case Error::DeviceDisconnected: return "DeviceDisconnected";
         }
         return "";
     }
 
     const uint32_t getBaudrate() const { return mBaudrate; }
 
-    static std::vector<std::string> enumerateComPorts() {
+    const uint32_t getDataBits() const { return mDataBits; }
 
-        std::vector<std::string> validPorts;
-        const uint32_t MAX_PORTS = 255;
-        char path[1024];
-        for (uint32_t k = 0; k < MAX_PORTS; k++) {
-            std::string port_name = "COM" + std::to_string(k);
-            DWORD test = QueryDosDevice(port_name.c_str(), path, 1024);
-            if (test == 0) continue;
-            validPorts.push_back(port_name);
-        }
+    const uint32_t getParity() const { return mParity; }
+
+    const uint32_t getStopBits() const { return mStopBits; }
+
+    // Changes the line settings of an open port in place, without reopening it.
+    Error applySettings(const uint32_t baudrate, const DataBits databits, const Parity parity, const StopBits stopbits) {
+        std::scoped_lock<std::mutex> lock(mMutex);
+        mBaudrate = baudrate;
+        mDataBits = databits;
+        mParity = parity;
+        mStopBits = stopbits;
+        if (!mIsOpen) return Error::None;
+        mBuffer.clear();
+        mError = configurePort();
+        return mError;
+    }
 
-        return validPorts;
+    LineErrors getLineErrors() {
+        std::scoped_lock<std::mutex> lock(mMutex);
+        return mLineErrors;
+    }
 
+    void resetLineErrors() {
+        std::scoped_lock<std::mutex> lock(mMutex);
+        mLineErrors = LineErrors{};
     }
 
+    // Listeners must be added before the reader thread starts and must not call back into Serial.
+    void addReceiveListener(ReceiveListener listener) { mReceiveListeners.push_back(std::move(listener)); }
+
 private:
+
+    Error openHandle(const bool purge) {
+
+        if (mSimulator) {
+            if (!mSimulator->open(std::chrono::steady_clock::now())) return Error::UnableToOpenPort;
+            mIsOpen = true;
+            return configurePort(purge);
+        }
+
+        mSerialHandle = CreateFile(
+            ("\\\\.\\" + mPort).c_str(),
+            GENERIC_READ | GENERIC_WRITE,
+            0,
+            nullptr,
+            OPEN_EXISTING,
+            FILE_ATTRIBUTE_NORMAL,
+            nullptr
+        );
+
+        if (mSerialHandle == INVALID_HANDLE_VALUE) {
+            return Error::UnableToOpenPort;
+        } else {
+            mIsOpen = true;
+        }
+
+        return configurePort(purge);
+    }
+
+    void countLineErrors(const DWORD err) {
+        if (err & CE_FRAME)    { mLineErrors.framing++; }
+        if (err & CE_RXPARITY) { mLineErrors.parity++; }
+        if (err & CE_BREAK)    { mLineErrors.breaks++; }
+        if (err & CE_OVERRUN)  { mLineErrors.overrun++; }
+        if (err & CE_RXOVER)   { mLineErrors.rxOver++; }
+    }
+
+    void closeHandle() {
+        if (mIsOpen && !mSimulator) { CloseHandle(mSerialHandle); }
+        mSerialHandle = nullptr;
+        mIsOpen = false;
+    }
+
+    size_t readSimulated() {
+
+        const size_t offset = mBuffer.size();
+        if (offset >= MAX_BUFFERED_BYTES) { return 0; }
+
+        const auto now = std::chrono::steady_clock::now();
+        mBuffer.resize(offset + std::min(MAX_BUFFERED_BYTES - offset, SIMULATED_READ_BYTES));
+        const auto bytesRead = mSimulator->read(std::span(mBuffer).subspan(offset), now);
+        mBuffer.resize(offset + bytesRead.value_or(0));
+
+        if (!bytesRead) { handleDisconnect(); return 0; }
+
+        if (*bytesRead > 0) {
+            for (const auto& listener : mReceiveListeners) { listener(std::span<const uint8_t>(&mBuffer[offset], *bytesRead), now); }
+        }
+        return *bytesRead;
+    }
+
+    void handleDisconnect() {
+        closeHandle();
+        mError = Error::DeviceDisconnected;
+        mReconnecting = true;
+        mReconnectAttempts = 0;
+        mNextReconnect = std::chrono::steady_clock::now();
+    }
+
+    static constexpr std::chrono::milliseconds RECONNECT_MIN_BACKOFF{5};
+    static constexpr std::chrono::milliseconds RECONNECT_MAX_BACKOFF{500};
+    static constexpr size_t MAX_BUFFERED_BYTES = 4 * 1024 * 1024;
+    static constexpr uint32_t DEFAULT_QUEUE_SIZE = 4096;
+    static constexpr char XON  = 0x11;
+    static constexpr char XOFF = 0x13;
+    static constexpr size_t SIMULATED_READ_BYTES = 64 * 1024;    // what one ReadFile of a large driver queue returns
     
     static constexpr std::array<const char*,4> sLineEndings = {"\r\n", "\n", "\r", ""};
     Error mError = Error::None;
@@ -228,11 +438,20 @@ private:
     uint32_t mDataBits = DataBits::EIGHT;
     uint32_t mParity   = Parity::NONE;
     uint32_t mStopBits = StopBits::ONE;
+    FlowControl mFlowControl = FlowControl::None;
+    uint32_t mRxQueueSize = 0;
+    uint32_t mTxQueueSize = 0;
     HANDLE mSerialHandle = nullptr;
-    bool mIsOpen = false;
+    std::atomic<bool> mIsOpen = false;
+    std::atomic<bool> mReconnecting = false;
+    std::atomic<uint32_t> mReconnectAttempts = 0;
+    std::chrono::steady_clock::time_point mNextReconnect;
+
+    LineErrors mLineErrors;
+    std::vector<ReceiveListener> mReceiveListeners;
+    std::unique_ptr<SimulatedDevice> mSimulator;
 
-    std::array<uint8_t, 8192> mBuffer;
-    size_t mNumBytesInBuffer = 0;
+    std::vector<uint8_t> mBuffer;
     std::mutex mMutex;
 
 };
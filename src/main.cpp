@@ -21,25 +21,44 @@
 #include <format>
 #include <chrono>
 #include <vector>
+#include <span>
+#include <charconv>
+#include <optional>
+#include <string_view>
 #include <fstream>
 
 #include "serial_windows.hpp"
+#include <timeapi.h>
 #include "SerialConfigView.hpp"
 #include "PreviousCommandsView.hpp"
 #include "AsciiView.hpp"
+#include "DecoderPipeline.hpp"
+#include "GapFramer.hpp"
+#include "PlotView.hpp"
+#include "PortWatcher.hpp"
+#include "Exporter.hpp"
+#include "TriggerCapture.hpp"
+#include "LatencyProbe.hpp"
+#include "SocketBridge.hpp"
 #include "SendView.hpp"
 #include "Utils.hpp"
 
 constexpr size_t fps = 1000 / 60;
+constexpr size_t MAX_PARSE_BYTES_PER_FRAME = 256 * 1024;
+constexpr size_t MAX_FRAME_LENGTH = 1024 * 1024;
+constexpr uint32_t MAX_QUEUE_SIZE = 16 * 1024 * 1024;
 
 using namespace ftxui;
 
-std::array<uint8_t, 8192> buf;
+std::vector<uint8_t> rxBytes;
+size_t rxParsed = 0;
+std::string bridgeTxBytes;
 
 size_t viewableTextRows = 0;
 size_t viewableCharsInRow = 0;
 
 std::atomic<bool> running = true;
+std::atomic<bool> finePolling = false;
 
 enum class TuiState {
     VIEW,
@@ -58,11 +77,75 @@ SendView sendView;
 AsciiView asciiView;
 SerialConfigView serialConfigView(serial);
 PreviousCommandsView previousCommandsView;
+DecoderPipeline decoderPipeline;
+GapFramer gapFramer(decoderPipeline);
+PlotView plotView;
+PortWatcher portWatcher;
+Exporter exporter;
+TriggerCapture triggerCapture;
+LatencyProbe latencyProbe(serial);
+SocketBridge socketBridge(serial);
+ExportFormat exportFormat = ExportFormat::Text;
+std::string exportStatus;
+std::vector<PortInfo> availablePorts;
+std::vector<Frame> decodedFrames;
 
 constexpr uint8_t MAJOR_VERSION = 0;
 constexpr uint8_t MINOR_VERSION = 1;
 constexpr uint8_t DEV_VERSION   = 0;
 
+// A whole decimal argument within [min, max], nullopt for anything else.
+template<typename T>
+std::optional<T> parseNumber(std::string_view arg, const T min, const T max) {
+    T value{};
+    const auto [ptr, ec] = std::from_chars(arg.data(), arg.data() + arg.size(), value);
+    if (ec != std::errc() || ptr != arg.data() + arg.size() || value < min || value > max) return std::nullopt;
+    return value;
+}
+
+// Each count is the number of ClearCommError polls since the port was opened that
+// reported the flag, not the number of errors: one poll may cover many lost bytes or
+// bad characters. All zero still means nothing was lost.
+std::string lineErrorStatus(const Serial::LineErrors& errors) {
+    return std::format("OVR {} QOVR {} FRM {} PAR {}", errors.overrun, errors.rxOver, errors.framing, errors.parity);
+}
+
+std::string scrollbackStatus() {
+    const auto stats = asciiView.getScrollbackStats();
+    if (stats.compressedPages == 0) { return std::format("{:.1f}MB", stats.residentBytes / 1048576.0); }
+    return std::format("{:.1f}/{}MB x{:.1f}", stats.residentBytes / 1048576.0, stats.budgetBytes / 1048576, stats.compressionRatio);
+}
+
+void startExport(const bool visibleOnly) {
+    using namespace std::chrono;
+    const auto file = std::format("tui-serial-{:%Y%m%d-%H%M%S}{}", floor<seconds>(system_clock::now()), Exporter::extension(exportFormat));
+    exporter.start(asciiView.getExportSource(visibleOnly), file, exportFormat);
+}
+
+// The reader polls every millisecond while read timestamps matter, they are only as
+// precise as the poll period. Windows needs a finer timer resolution for that.
+void updatePollResolution() {
+    const bool fine = latencyProbe.running() || gapFramer.enabled();
+    if (fine == finePolling) return;
+    finePolling = fine;
+    if (fine) { timeBeginPeriod(1); } else { timeEndPeriod(1); }
+}
+
+void toggleLatencyProbe() {
+    if (!latencyProbe.configured()) return;
+    latencyProbe.toggle();
+    updatePollResolution();
+}
+
+void updateGapFraming() {
+    gapFramer.setEnabled(decoderPipeline.getConfig().mode == FramingMode::IdleGap);
+    updatePollResolution();
+}
+
+uint32_t bitsPerCharacter() {
+    return 1 + serial.getDataBits() + ((serial.getParity() != Serial::Parity::NONE) ? 1 : 0) + ((serial.getStopBits() == Serial::StopBits::ONE) ? 1 : 2);
+}
+
 int main(int argc, char* argv[]) {
 
     const std::vector<std::string> argList(argv + 1, argv + argc);
@@ -71,7 +154,110 @@ int main(int argc, char* argv[]) {
         return 0;
     }
 
-        
+    std::vector<std::string> positionalArgs;
+    FrameDecoderConfig frameConfig;
+    TriggerConfig triggerConfig;
+    LatencyConfig latencyConfig;
+    SimulatorConfig simulatorConfig;
+    bool simulate = false;
+    uint16_t bridgePort = 0;
+    for (size_t i = 0; i < argList.size(); i++) {
+        const std::string& arg = argList[i];
+        const bool hasValue = (i + 1 < argList.size());
+        if (arg == "--trigger" && hasValue) {
+            triggerConfig.patterns.push_back(argList[++i]);
+        } else if (arg == "--trigger-hex" && hasValue) {
+            const auto bytes = TriggerCapture::parseHex(argList[++i]);
+            if (!bytes) { std::fprintf(stderr, "invalid hex pattern: %s\n", argList[i].c_str()); return 1; }
+            triggerConfig.patterns.push_back(*bytes);
+        } else if (arg == "--pre" && hasValue) {
+            if (!TriggerCapture::parseExtent(argList[++i], triggerConfig.preBytes, triggerConfig.preTime)) { std::fprintf(stderr, "invalid --pre: %s\n", argList[i].c_str()); return 1; }
+        } else if (arg == "--post" && hasValue) {
+            if (!TriggerCapture::parseExtent(argList[++i], triggerConfig.postBytes, triggerConfig.postTime)) { std::fprintf(stderr, "invalid --post: %s\n", argList[i].c_str()); return 1; }
+        } else if (arg == "--trigger-dir" && hasValue) {
+            triggerConfig.directory = argList[++i];
+        } else if (arg == "--simulate" && hasValue) {
+            const auto pattern = SimulatedDevice::parsePattern(argList[++i]);
+            if (!pattern) { std::fprintf(stderr, "unknown pattern %s, expected lines, binary, telemetry or echo\n", argList[i].c_str()); return 1; }
+            simulatorConfig.pattern = *pattern;
+            simulate = true;
+        } else if (arg == "--sim-rate" && hasValue) {
+            simulatorConfig.byteRate = static_cast<uint32_t>(std::stoul(argList[++i]));
+        } else if (arg == "--sim-seed" && hasValue) {
+            simulatorConfig.seed = std::stoull(argList[++i]);
+        } else if (arg == "--sim-disconnect" && hasValue) {
+            const int meanTimeToDisconnect = std::stoi(argList[++i]);
+            if (meanTimeToDisconnect < 0) { std::fprintf(stderr, "invalid --sim-disconnect: %s\n", argList[i].c_str()); return 1; }
+            simulatorConfig.meanTimeToDisconnect = std::chrono::milliseconds(meanTimeToDisconnect);
+        } else if (arg == "--flow" && hasValue) {
+            const std::string flow = argList[++i];
+            if (flow == "none") { serial.setFlowControl(Serial::FlowControl::None); }
+            else if (flow == "rtscts") { serial.setFlowControl(Serial::FlowControl::RtsCts); }
+            else if (flow == "xonxoff") { serial.setFlowControl(Serial::FlowControl::XonXoff); }
+            else { std::fprintf(stderr, "unknown flow control %s, expected none, rtscts or xonxoff\n", flow.c_str()); return 1; }
+        } else if (arg == "--rx-queue" && hasValue) {
+            const auto size = parseNumber<uint32_t>(argList[++i], 1, MAX_QUEUE_SIZE);
+            if (!size) { std::fprintf(stderr, "invalid --rx-queue: %s\n", argList[i].c_str()); return 1; }
+            serial.setQueueSizes(*size, serial.getTxQueueSize());
+        } else if (arg == "--tx-queue" && hasValue) {
+            const auto size = parseNumber<uint32_t>(argList[++i], 1, MAX_QUEUE_SIZE);
+            if (!size) { std::fprintf(stderr, "invalid --tx-queue: %s\n", argList[i].c_str()); return 1; }
+            serial.setQueueSizes(serial.getRxQueueSize(), *size);
+        } else if (arg == "--gap" && hasValue) {
+            // idle gap framing from the start, the value in microseconds or auto
+            if (const std::string value = argList[++i]; value != "auto") { gapFramer.setGap(std::chrono::microseconds(std::stoi(value))); }
+            frameConfig.mode = FramingMode::IdleGap;
+        } else if (arg == "--frame-delim" && hasValue) {
+            const auto delimiter = TriggerCapture::parseHex(argList[++i]);
+            if (!delimiter || delimiter->size() != 1) { std::fprintf(stderr, "invalid --frame-delim: %s, expected one hex byte\n", argList[i].c_str()); return 1; }
+            frameConfig.delimiter = static_cast<uint8_t>(delimiter->front());
+            frameConfig.mode = FramingMode::Delimiter;
+        } else if (arg == "--frame-len" && hasValue) {
+            const auto length = parseNumber<size_t>(argList[++i], 1, MAX_FRAME_LENGTH);
+            if (!length) { std::fprintf(stderr, "invalid --frame-len: %s\n", argList[i].c_str()); return 1; }
+            frameConfig.fixedLength = *length;
+            frameConfig.mode = FramingMode::FixedLength;
+        } else if (arg == "--length-field" && hasValue) {
+            // the size of the length prefix, 1, 2 (little endian) or 2be
+            const std::string field = argList[++i];
+            if (field == "1") { frameConfig.lengthFieldSize = 1; frameConfig.lengthBigEndian = false; }
+            else if (field == "2") { frameConfig.lengthFieldSize = 2; frameConfig.lengthBigEndian = false; }
+            else if (field == "2be") { frameConfig.lengthFieldSize = 2; frameConfig.lengthBigEndian = true; }
+            else { std::fprintf(stderr, "invalid --length-field %s, expected 1, 2 or 2be\n", field.c_str()); return 1; }
+            frameConfig.mode = FramingMode::LengthPrefixed;
+        } else if (arg == "--frame-max" && hasValue) {
+            const auto length = parseNumber<size_t>(argList[++i], 1, MAX_FRAME_LENGTH);
+            if (!length) { std::fprintf(stderr, "invalid --frame-max: %s\n", argList[i].c_str()); return 1; }
+            frameConfig.maxFrameLength = *length;
+        } else if (arg == "--scrollback-mb" && hasValue) {
+            const auto megabytes = parseNumber<size_t>(argList[++i], 1, 64 * 1024);
+            if (!megabytes) { std::fprintf(stderr, "invalid --scrollback-mb: %s\n", argList[i].c_str()); return 1; }
+            asciiView.setScrollbackBudget(*megabytes * 1024 * 1024);
+        } else if (arg == "--bridge" && hasValue) {
+            const auto port = parseNumber<uint16_t>(argList[++i], 1, 65535);
+            if (!port) { std::fprintf(stderr, "invalid --bridge: %s\n", argList[i].c_str()); return 1; }
+            bridgePort = *port;
+        } else if (arg == "--latency" && hasValue) {
+            latencyConfig.request = LatencyProbe::unescape(argList[++i]);
+        } else if (arg == "--reply" && hasValue) {
+            latencyConfig.reply = LatencyProbe::unescape(argList[++i]);
+        } else if (arg == "--interval" && hasValue) {
+            latencyConfig.interval = std::chrono::milliseconds(std::max(1, std::stoi(argList[++i])));
+        } else if (arg == "--timeout" && hasValue) {
+            latencyConfig.timeout = std::chrono::milliseconds(std::max(1, std::stoi(argList[++i])));
+        } else {
+            positionalArgs.push_back(arg);
+        }
+    }
+
+    if (frameConfig.fixedLength > frameConfig.maxFrameLength) {
+        std::fprintf(stderr, "--frame-len %zu exceeds the maximum frame length %zu\n", frameConfig.fixedLength, frameConfig.maxFrameLength);
+        return 1;
+    }
+
+    // C-f and C-r cycle mode and crc later on, the framing parameters given here stay
+    decoderPipeline.setConfig(frameConfig);
+
     auto screen = ScreenInteractive::Fullscreen();
     auto screen_dim = Terminal::Size();
 
@@ -85,14 +271,25 @@ int main(int argc, char* argv[]) {
                 text(" j    scroll down"),
                 text(" K    scroll up 5"),
                 text(" J    scroll down 5"),
+                text(" g    toggle telemetry plot"),
+                text(" x    export scrollback / cancel"),
+                text(" X    export visible rows"),
+                text(" C-x  cycle export format"),
+                text(" T    arm / disarm trigger capture"),
+                text(" L    start / stop latency probe"),
+                text(" D    toggle flood decimation"),
                 text(" :    send mode"),
                 text(" C-e  port configuration"),
                 text(" C-t  toggle timeStamps"),
                 text(" C-p  pause no flush"),
                 text(" C-o  clear serial view"),
+                text(" C-f  cycle frame decoder"),
+                text("      GAP resolves idle time to about 1-2ms"),
+                text(" C-r  cycle frame crc check"),
                 text(" ^    (send) view send history"),
                 text(" d    (history) remove from history"),
                 text(" e    (history) edit from history"),
+                text(" /    (history) fuzzy filter history"),
                 text(" C-b  (send) send break state"),
                 text(" C-k  (send) toggle touch type"),
                 text(" C-u  (send) toggle upper case"),
@@ -107,8 +304,12 @@ int main(int argc, char* argv[]) {
     auto main_window_renderer = Renderer([&] {
 
         std::string statusString;
+        const auto lineErrors = serial.getLineErrors();
+        const bool linesLost = (lineErrors.overrun + lineErrors.rxOver + lineErrors.framing + lineErrors.parity) > 0;
         if (serial.isConnected()) {
             statusString = std::format("TUI Serial: Connected to {} @ {} {}/{}", serial.getPortName(), serial.getBaudrate(), asciiView.getIndex(), asciiView.getNumRows());
+        } else if (serial.isReconnecting()) {
+            statusString = std::format("TUI Serial: Lost {}, reconnecting (attempt {})", serial.getPortName(), serial.getReconnectAttempts());
         } else {
             statusString = std::format("TUI Serial: Not Connected");
         }
@@ -125,11 +326,27 @@ int main(int argc, char* argv[]) {
                     text((sendView.sendOnType() && tuiState == TuiState::SEND) ? "TOUCH TYPE" : "") | inverted | color(Color::Green),
                     separatorEmpty(),
                     text((viewPaused) ? "PAUSED" : "") | color(Color::Red) | inverted,
+                    separatorEmpty(),
+                    text((decoderPipeline.enabled()) ? decoderPipeline.getStatus() : "") | color(Color::Yellow),
+                    separatorEmpty(),
+                    text(gapFramer.getStatus()) | color(Color::Yellow),
+                    separatorEmpty(),
+                    text(triggerCapture.getStatus()) | color(Color::Magenta),
+                    separatorEmpty(),
+                    text(latencyProbe.getStatus()) | color(Color::Cyan),
+                    separatorEmpty(),
+                    text(socketBridge.getStatus()) | color(Color::GrayLight),
+                    separatorEmpty(),
+                    text(serial.isConnected() ? lineErrorStatus(lineErrors) : "") | color(linesLost ? Color::Red : Color::GrayLight),
+                    separatorEmpty(),
+                    text(scrollbackStatus()) | color(Color::GrayLight),
+                    separatorEmpty(),
+                    text(std::format("[{}] {}", Exporter::name(exportFormat), exporter.getStatus())) | color(Color::GrayLight),
                     filler(),
                     text(serial.getLastError()) | color(Color::Red)
                 }) | border,
                 sendView.getView(),
-                asciiView.getView(),
+                (plotView.enabled()) ? plotView.getView() | flex : asciiView.getView(),
             }) | size(WIDTH, GREATER_THAN, 120);
 
         if (helpMenuActive) {
@@ -151,6 +368,7 @@ int main(int argc, char* argv[]) {
     main_window_renderer |= CatchEvent([&](Event event) {
 
         if (event == Event::Escape) {
+            if (tuiState == TuiState::HISTORY) { previousCommandsView.clearFilter(); }
             tuiState = TuiState::VIEW;
             return true;
         }
@@ -183,6 +401,28 @@ int main(int argc, char* argv[]) {
                         case ':':
                             tuiState = TuiState::SEND;
                             break;
+                        case 'g':
+                            plotView.toggleView();
+                            break;
+                        case 'x':
+                            if (exporter.running()) {
+                                exporter.cancel();
+                            } else {
+                                startExport(false);
+                            }
+                            break;
+                        case 'X':
+                            startExport(true);
+                            break;
+                        case 'T':
+                            triggerCapture.toggleArmed();
+                            break;
+                        case 'L':
+                            toggleLatencyProbe();
+                            break;
+                        case 'D':
+                            asciiView.toggleDecimation();
+                            break;
                         default:
                             // not a command
                             break;
@@ -193,11 +433,19 @@ int main(int argc, char* argv[]) {
                     serialConfigView.listAvailableComPorts(serial);
                 } else if (event == Event::Special({15})) { // C-o
                     asciiView.clearView();
+                    plotView.clear();
                 } else if (event == Event::Special({16})) { // C-p
                     // pause serial view with flush
                     // TODO: allows pausing the serial terminal, but still capture input in the background 
                 } else if (event == Event::Special({20})) {
                     asciiView.toggleTimeStamps();
+                } else if (event == Event::Special({24})) { // C-x
+                    exportFormat = static_cast<ExportFormat>((static_cast<int>(exportFormat) + 1) % (static_cast<int>(ExportFormat::Csv) + 1));
+                } else if (event == Event::Special({6})) { // C-f
+                    decoderPipeline.cycleFramingMode();
+                    updateGapFraming();
+                } else if (event == Event::Special({18})) { // C-r
+                    decoderPipeline.cycleCrcMode();
                 } else {
                     // not a command
                 }
@@ -245,13 +493,19 @@ int main(int argc, char* argv[]) {
             case TuiState::CONFIG:
                 return serialConfigView.OnEvent(event);
             case TuiState::HISTORY:
-                if (const char c = event.character().at(0); event.is_character()) {
+                if (previousCommandsView.filtering() && previousCommandsView.OnFilterEvent(event)) {
+                    return true;
+                } else if (const char c = event.character().at(0); event.is_character()) {
                     switch (c) {
+                        case '/':
+                            previousCommandsView.startFilter();
+                            break;
                         case 'd':
                             previousCommandsView.removeFromHistory();
                             break;
                         case 'e':
                             sendView.setUserInput(previousCommandsView.getSendFromHistory());
+                            previousCommandsView.clearFilter();
                             tuiState = TuiState::SEND;
                             break;
                         default:
@@ -277,36 +531,53 @@ int main(int argc, char* argv[]) {
     Loop loop(&screen, main_window_renderer);
     auto pollSerial = [&]() {
         while (running) {
-            std::this_thread::sleep_for(std::chrono::milliseconds(16));
+            std::this_thread::sleep_for(std::chrono::milliseconds(finePolling ? 1 : 16));
+            serial.maintainConnection();
             if (viewPaused) continue;
             serial.read();
+            gapFramer.onPoll(std::chrono::steady_clock::now());
         }
     };
 
 
-    if (argc > 1) {
+    // the --sim-* options only tune the simulation, --simulate is what replaces the port
+    if (simulate) {
+        // the only positional argument left is the baud rate the simulation pretends to run at
+        const uint32_t baudrate = positionalArgs.empty() ? 115200 : std::stoi(positionalArgs.back());
+        serial.openSimulated(simulatorConfig, baudrate);
+    } else if (!positionalArgs.empty()) {
         // TODO: Sanity check on input args
-        std::string port(argv[1]);
+        std::string port(positionalArgs[0]);
         uint32_t baudrate = 115200;
-        if (argc > 2) { baudrate = std::stoi(argv[2]); }
+        if (positionalArgs.size() > 1) { baudrate = std::stoi(positionalArgs[1]); }
         
         serial.open(port, baudrate);
 
     }
 
-    {
-        std::filesystem::path appDataFile = getApplicationFolderDirectory();
-        appDataFile = appDataFile / "tui-serial" / "history.txt";
-        if (std::filesystem::exists(appDataFile)) {
-            std::ifstream file(appDataFile.string());
-            std::string line;
-            while(std::getline(file, line)) {
-                previousCommandsView.addToHistory(line);
-            }
-        }
+    if (const std::filesystem::path appDataFolder = getApplicationFolderDirectory(); !appDataFolder.empty()) {
+        previousCommandsView.load(appDataFolder / "tui-serial" / "history.log", appDataFolder / "tui-serial" / "history.txt");
     }
 
+    if (!triggerConfig.patterns.empty()) {
+        triggerCapture.configure(std::move(triggerConfig));
+        serial.addReceiveListener([](std::span<const uint8_t> data, const std::chrono::steady_clock::time_point time) { triggerCapture.onReceive(data, time); });
+    }
+
+    if (!latencyConfig.request.empty() && !latencyConfig.reply.empty()) {
+        latencyProbe.configure(std::move(latencyConfig));
+        serial.addReceiveListener([](std::span<const uint8_t> data, const std::chrono::steady_clock::time_point time) { latencyProbe.onReceive(data, time); });
+    }
+
+    if (bridgePort != 0 && socketBridge.start(bridgePort)) {
+        serial.addReceiveListener([](std::span<const uint8_t> data, const std::chrono::steady_clock::time_point time) { socketBridge.onReceive(data, time); });
+    }
+
+    serial.addReceiveListener([](std::span<const uint8_t> data, const std::chrono::steady_clock::time_point time) { gapFramer.onReceive(data, time); });
+    updateGapFraming();
+
     std::thread serialThread(pollSerial);
+    portWatcher.start();
 
     loop.RunOnce();
     while (!loop.HasQuitted()) {
@@ -314,43 +585,74 @@ int main(int argc, char* argv[]) {
         viewableCharsInRow = std::max(screen.dimx() - 2, 80);
         viewableTextRows   = std::max(screen.dimy() - 8, 10);
 
-        if (const auto bytesRead = serial.copyBytes(buf.data()); bytesRead > 0) {
-            asciiView.parseBytes(std::span(buf.begin(), bytesRead), viewableCharsInRow);
-            asciiView.resetView(viewableTextRows);
-            screen.PostEvent(Event::Custom);
-        }
+        if (serialConfigView.pollAutoDetect()) { screen.PostEvent(Event::Custom); }
 
-        loop.RunOnce();
-        std::this_thread::sleep_for(std::chrono::milliseconds(fps));
-
-    }
+        if (gapFramer.enabled()) { gapFramer.setLineSettings(serial.getBaudrate(), bitsPerCharacter()); }
 
-    const auto previousCommands = previousCommandsView.getCommandHistory();    
+        if (portWatcher.update(availablePorts)) {
+            serialConfigView.setAvailableComPorts(availablePorts);
+            if (serial.isReconnecting() && portWatcher.isPresent(serial.getPortName())) { serial.reconnectNow(); }
+            screen.PostEvent(Event::Custom);
+        }
 
-    std::filesystem::path appDataFolder = getApplicationFolderDirectory();
-    
-    if (!appDataFolder.empty()) {
-        
-        appDataFolder = appDataFolder / "tui-serial";
+        // The reader keeps buffering in the background, everything it read is taken once the
+        // previous batch is parsed. At most MAX_PARSE_BYTES_PER_FRAME go into the views per
+        // frame, the rest is carried over, so the frame time stays bounded whatever the input
+        // rate while nothing is lost. The view decimates what does not fit on screen.
+        if (rxParsed == rxBytes.size()) {
+            rxParsed = 0;
+            serial.copyBytes(rxBytes);
+        }
 
-        if (!std::filesystem::exists(appDataFolder)) {
-            std::filesystem::create_directory(appDataFolder);
+        if (rxParsed < rxBytes.size()) {
+            const auto slice = std::span<const uint8_t>(rxBytes).subspan(rxParsed, std::min(rxBytes.size() - rxParsed, MAX_PARSE_BYTES_PER_FRAME));
+            rxParsed += slice.size();
+            if (plotView.enabled()) {
+                plotView.parseBytes(slice);
+                screen.PostEvent(Event::Custom);
+            }
+            if (decoderPipeline.enabled()) {
+                // in idle gap mode the reader thread feeds the pipeline with the frame boundaries
+                if (!gapFramer.enabled()) { decoderPipeline.push(slice); }
+            } else {
+                asciiView.parseBytes(slice, viewableCharsInRow);
+                asciiView.resetView(viewableTextRows);
+                screen.PostEvent(Event::Custom);
+            }
         }
 
-        auto appDataFile = appDataFolder / "history.txt";
+        if (decoderPipeline.copyFrames(decodedFrames) > 0) {
+            for (const auto& frame : decodedFrames) {
+                asciiView.addFrame(frame, viewableCharsInRow);
+            }
+            asciiView.resetView(viewableTextRows);
+            screen.PostEvent(Event::Custom);
+        }
 
-        std::ofstream file(appDataFile.string(), std::ios::trunc);
+        if (socketBridge.takeTransmitted(bridgeTxBytes)) {
+            if (transmitEnabled) { asciiView.addTransmitMessage(bridgeTxBytes); }
+            screen.PostEvent(Event::Custom);
+        }
 
-        for (const auto cmds : previousCommands) {
-            file << cmds << '\n';
+        // redraw while an export runs and once more when its result times out
+        if (const auto status = exporter.getStatus(); status != exportStatus) {
+            exportStatus = status;
+            screen.PostEvent(Event::Custom);
         }
 
-        
+        loop.RunOnce();
+        std::this_thread::sleep_for(std::chrono::milliseconds(fps));
+
     }
 
-    
+    if (latencyProbe.running()) { latencyProbe.stop(); }
+    gapFramer.setEnabled(false);
+    updatePollResolution();
+
     running = false;
     serialThread.join();
+    socketBridge.stop();
+    portWatcher.stop();
 
     return 0;
 }